@@ -0,0 +1,136 @@
+#include <stdio.h>
+#include <vector>
+
+#include "admission.h"
+#include "ramdis-server.h"
+#include "Cycles.h"
+
+using RAMCloud::Cycles;
+
+static uint64_t maxQueued;    /* 0 for no limit. */
+static uint64_t maxP99Us;     /* 0 for no limit. */
+static int action;
+static std::vector<latencyWindow*> windows; /* One per executor. */
+
+static std::atomic<uint64_t> lastCheck(0); /* Cycles::rdtsc() */
+static std::atomic<bool> overloaded(false);
+static std::atomic<uint64_t> admitted(0);
+static std::atomic<uint64_t> shed(0);
+static std::atomic<uint64_t> pauses(0);
+
+latencyWindow::latencyWindow() {
+  for (auto& epoch : slotEpochs)
+    epoch.store(0, std::memory_order_relaxed);
+}
+
+/* The number of the ADMIT_SLOT_MS long slot of time that now falls in. */
+static uint64_t slotEpoch(uint64_t now) {
+  return Cycles::toMicroseconds(now) / (ADMIT_SLOT_MS * 1000);
+}
+
+void admissionInit(uint64_t queued, uint64_t p99Us, int whenOverloaded,
+    int numExecutors) {
+  maxQueued = queued;
+  maxP99Us = p99Us;
+  action = whenOverloaded;
+  for (int i = 0; i < numExecutors; i++)
+    windows.push_back(new latencyWindow());
+}
+
+bool admissionEnabled() {
+  return maxQueued != 0 || maxP99Us != 0;
+}
+
+int admissionAction() {
+  return action;
+}
+
+latencyWindow *admissionWindow(int executor) {
+  return windows[executor];
+}
+
+/* Record that a command took cycles to execute. Only the executor owning the
+ * window may call this. A slot left over from an earlier pass around the
+ * window is cleared before it is used again. */
+void admissionRecord(latencyWindow *window, uint64_t cycles) {
+  uint64_t epoch = slotEpoch(Cycles::rdtsc());
+  int i = epoch % ADMIT_WINDOW_SLOTS;
+  if (window->slotEpochs[i].load(std::memory_order_relaxed) != epoch) {
+    window->slots[i].clear();
+    window->slotEpochs[i].store(epoch, std::memory_order_relaxed);
+  }
+  window->slots[i].record(Cycles::toMicroseconds(cycles));
+}
+
+/* p99 of the command times of all executors over the window. */
+static uint64_t windowP99(uint64_t now) {
+  uint64_t epoch = slotEpoch(now);
+  histogramSnapshot snapshot;
+  for (auto window : windows) {
+    for (int i = 0; i < ADMIT_WINDOW_SLOTS; i++) {
+      uint64_t slot = window->slotEpochs[i].load(std::memory_order_relaxed);
+      if (slot + ADMIT_WINDOW_SLOTS > epoch)
+        snapshot.add(window->slots[i]);
+    }
+  }
+  return snapshot.percentile(99.0);
+}
+
+/* Whether new requests should be turned away. Whoever calls this first once
+ * ADMIT_CHECK_MS have gone by works the answer out again. */
+bool admissionOverloaded() {
+  if (!admissionEnabled())
+    return false;
+
+  uint64_t now = Cycles::rdtsc();
+  uint64_t last = lastCheck.load(std::memory_order_relaxed);
+  if (Cycles::toMicroseconds(now - last) >= ADMIT_CHECK_MS * 1000 &&
+      lastCheck.compare_exchange_strong(last, now)) {
+    bool over = (maxQueued != 0 && queuedRequests() > maxQueued) ||
+        (maxP99Us != 0 && windowP99(now) > maxP99Us);
+    if (over != overloaded.load(std::memory_order_relaxed)) {
+      serverLog(LL_WARN, over ? "Overloaded, turning new requests away" :
+          "No longer overloaded, admitting new requests");
+      overloaded.store(over, std::memory_order_relaxed);
+    }
+  }
+  return overloaded.load(std::memory_order_relaxed);
+}
+
+/* Count a request that admission control let in or turned away. */
+void admissionCount(bool admit) {
+  (admit ? admitted : shed).fetch_add(1, std::memory_order_relaxed);
+}
+
+/* Count a client that stopped being read from because of overload. */
+void admissionCountPause() {
+  pauses.fetch_add(1, std::memory_order_relaxed);
+}
+
+/* Append the admission section of INFO. */
+void admissionInfo(std::string *info) {
+  char buf[1024];
+  snprintf(buf, sizeof(buf),
+      "# Admission\r\n"
+      "admission_enabled:%d\r\n"
+      "admission_action:%s\r\n"
+      "admission_max_queued:%llu\r\n"
+      "admission_max_p99_us:%llu\r\n"
+      "admission_overloaded:%d\r\n"
+      "requests_queued:%zu\r\n"
+      "command_p99_us:%llu\r\n"
+      "admitted_requests:%llu\r\n"
+      "rejected_requests:%llu\r\n"
+      "paused_reads:%llu\r\n",
+      admissionEnabled() ? 1 : 0,
+      action == ADMIT_PAUSE ? "pause" : "busy",
+      (unsigned long long)maxQueued,
+      (unsigned long long)maxP99Us,
+      overloaded.load(std::memory_order_relaxed) ? 1 : 0,
+      queuedRequests(),
+      (unsigned long long)windowP99(Cycles::rdtsc()),
+      (unsigned long long)admitted.load(std::memory_order_relaxed),
+      (unsigned long long)shed.load(std::memory_order_relaxed),
+      (unsigned long long)pauses.load(std::memory_order_relaxed));
+  info->append(buf);
+}
@@ -0,0 +1,51 @@
+#ifndef __ADMISSION_H
+#define __ADMISSION_H
+
+#include <stdint.h>
+#include <string>
+
+#include "histogram.h"
+
+/* Admission control. Executors record how long each command they run takes
+ * in a sliding window of ADMIT_WINDOW_SLOTS histograms per executor, each
+ * covering ADMIT_SLOT_MS. Reactors check before accepting a new request
+ * whether the server is overloaded: whether more requests than the limit are
+ * sitting in the request queues, or the p99 over the window is above the
+ * limit. The verdict is worked out again at most every ADMIT_CHECK_MS.
+ *
+ * While overloaded, new requests are either answered with -BUSY right away,
+ * or clients are not read from until the overload is over, which pushes back
+ * on them through TCP instead. Commands flagged 'a' or 't' in the command
+ * table (CLIENT, INFO and the like) are always let in, so the server can
+ * still be looked at. */
+
+#define ADMIT_WINDOW_SLOTS 10
+#define ADMIT_SLOT_MS 100
+#define ADMIT_CHECK_MS 10
+
+/* What to do with new requests while overloaded. */
+#define ADMIT_BUSY 0
+#define ADMIT_PAUSE 1
+
+#define BUSY_ERR "-BUSY Server is overloaded, try again later"
+
+/* The recent command times of one executor. */
+struct latencyWindow {
+  latencyWindow();
+  histogram slots[ADMIT_WINDOW_SLOTS];
+  std::atomic<uint64_t> slotEpochs[ADMIT_WINDOW_SLOTS]; /* Which slot time
+                                                         * each holds. */
+};
+
+void admissionInit(uint64_t maxQueued, uint64_t maxP99Us, int action,
+    int numExecutors);
+bool admissionEnabled();
+int admissionAction();
+latencyWindow *admissionWindow(int executor);
+void admissionRecord(latencyWindow *window, uint64_t cycles);
+bool admissionOverloaded();
+void admissionCount(bool admitted);
+void admissionCountPause();
+void admissionInfo(std::string *info);
+
+#endif // __ADMISSION_H
@@ -0,0 +1,265 @@
+#include <stdio.h>
+#include <string.h>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "cache.h"
+#include "Cycles.h"
+
+using RAMCloud::Cycles;
+
+struct cacheEntry {
+  cacheEntry() : key(), reply(), version(0), validatedAt(0), uses(0),
+    used(false) {}
+  std::string key;
+  std::shared_ptr<const std::string> reply;
+  uint64_t version;
+  uint64_t validatedAt;   /* Cycles::rdtsc() when last read or revalidated. */
+  uint8_t uses;           /* Hits since the hand last passed, up to
+                           * CACHE_USE_MAX. */
+  bool used;              /* False for slots in freeSlots. */
+};
+
+struct cacheShard {
+  cacheShard() : lock(), index(), slots(), freeSlots(), hand(0), bytes(0),
+    epoch(0), stats() {}
+  std::mutex lock;
+  std::unordered_map<std::string, size_t> index; /* Key to slot. */
+  std::vector<cacheEntry> slots; /* The clock. */
+  std::vector<size_t> freeSlots;
+  size_t hand;
+  size_t bytes;           /* Charged against shardBytes. */
+  uint64_t epoch;         /* Bumped by every invalidation. */
+  cacheStats stats;
+};
+
+static cacheShard shards[CACHE_SHARDS];
+static size_t shardBytes;  /* Size limit of each shard, 0 if disabled. */
+static uint64_t ttlMs;
+static uint64_t ttlCycles; /* 0 if entries never need revalidating. */
+
+static size_t entryCost(const cacheEntry &e) {
+  return e.key.size() + e.reply->size() + CACHE_ENTRY_OVERHEAD;
+}
+
+static cacheShard &shardOf(const std::string &key) {
+  return shards[std::hash<std::string>()(key) % CACHE_SHARDS];
+}
+
+/* Drop the entry in slot i. */
+static void removeEntry(cacheShard *s, size_t i) {
+  cacheEntry &e = s->slots[i];
+  s->bytes -= entryCost(e);
+  s->index.erase(e.key);
+  e.key.clear();
+  e.key.shrink_to_fit();
+  e.reply.reset();
+  e.used = false;
+  s->freeSlots.push_back(i);
+  s->stats.entries--;
+}
+
+/* Advance the hand until it finds an entry that has not been hit since it
+ * last came by, and evict it. */
+static void evictOne(cacheShard *s) {
+  while (true) {
+    size_t i = s->hand;
+    s->hand = (s->hand + 1) % s->slots.size();
+    cacheEntry &e = s->slots[i];
+    if (!e.used)
+      continue;
+    if (e.uses > 0) {
+      e.uses--;
+      continue;
+    }
+    removeEntry(s, i);
+    s->stats.evictions++;
+    return;
+  }
+}
+
+/* Enable the cache with room for maxBytes of keys and replies. Entries are
+ * revalidated once they are ttl milliseconds old, or never if ttl is 0. */
+void cacheInit(size_t maxBytes, uint64_t ttl) {
+  shardBytes = maxBytes / CACHE_SHARDS;
+  ttlMs = ttl;
+  ttlCycles = Cycles::fromNanoseconds(ttl * 1000000);
+}
+
+bool cacheEnabled() {
+  return shardBytes > 0;
+}
+
+/* Look key up, filling in what was found in *probe. The probe is needed
+ * again to insert what a miss reads from RAMCloud. */
+void cacheLookup(const argView &key, cacheProbe *probe) {
+  std::string k = key.str();
+  cacheShard &s = shardOf(k);
+  std::lock_guard<std::mutex> guard(s.lock);
+  probe->epoch = s.epoch;
+
+  auto it = s.index.find(k);
+  if (it == s.index.end()) {
+    probe->result = CACHE_MISS;
+    s.stats.misses++;
+    return;
+  }
+
+  cacheEntry &e = s.slots[it->second];
+  probe->version = e.version;
+  probe->reply = e.reply;
+  if (ttlCycles != 0 && Cycles::rdtsc() - e.validatedAt > ttlCycles) {
+    probe->result = CACHE_STALE;
+    s.stats.revalidations++;
+    return;
+  }
+
+  probe->result = CACHE_HIT;
+  if (e.uses < CACHE_USE_MAX)
+    e.uses++;
+  s.stats.hits++;
+}
+
+/* Cache reply, read from RAMCloud at version after probe missed or went
+ * stale. Dropped if the key may have been written since the probe. If the
+ * entry is already there at that version, it is only marked as validated. */
+void cacheInsert(const argView &key, const cacheProbe &probe,
+    const char *reply, size_t len, uint64_t version) {
+  std::string k = key.str();
+  size_t cost = k.size() + len + CACHE_ENTRY_OVERHEAD;
+  /* A few huge values would take the whole shard with them. */
+  if (cost > shardBytes / 4)
+    return;
+
+  cacheShard &s = shardOf(k);
+  std::lock_guard<std::mutex> guard(s.lock);
+  if (s.epoch != probe.epoch)
+    return;
+
+  auto it = s.index.find(k);
+  if (it != s.index.end()) {
+    cacheEntry &e = s.slots[it->second];
+    if (e.version == version) {
+      if (probe.result == CACHE_STALE)
+        s.stats.revalidationHits++;
+      e.validatedAt = Cycles::rdtsc();
+      return;
+    }
+    if (e.version > version)
+      return;
+    removeEntry(&s, it->second);
+  }
+
+  while (s.bytes + cost > shardBytes)
+    evictOne(&s);
+
+  size_t i;
+  if (s.freeSlots.empty()) {
+    i = s.slots.size();
+    s.slots.emplace_back();
+  } else {
+    i = s.freeSlots.back();
+    s.freeSlots.pop_back();
+  }
+
+  cacheEntry &e = s.slots[i];
+  e.key = std::move(k);
+  e.reply = std::make_shared<const std::string>(reply, len);
+  e.version = version;
+  e.validatedAt = Cycles::rdtsc();
+  e.uses = 0;
+  e.used = true;
+  s.index.emplace(e.key, i);
+  s.bytes += cost;
+  s.stats.inserts++;
+  s.stats.entries++;
+}
+
+/* RAMCloud still has the version a stale probe found, so the entry is good
+ * for another TTL, unless the key was invalidated since the probe. */
+void cacheRevalidated(const argView &key, const cacheProbe &probe) {
+  std::string k = key.str();
+  cacheShard &s = shardOf(k);
+  std::lock_guard<std::mutex> guard(s.lock);
+  if (s.epoch != probe.epoch) {
+    s.stats.revalidationsRaced++;
+    return;
+  }
+  s.stats.revalidationHits++;
+
+  auto it = s.index.find(k);
+  if (it != s.index.end() && s.slots[it->second].version == probe.version)
+    s.slots[it->second].validatedAt = Cycles::rdtsc();
+}
+
+/* Forget key, which was just written or removed. */
+void cacheInvalidate(const argView &key) {
+  std::string k = key.str();
+  cacheShard &s = shardOf(k);
+  std::lock_guard<std::mutex> guard(s.lock);
+  s.epoch++;
+  auto it = s.index.find(k);
+  if (it != s.index.end()) {
+    removeEntry(&s, it->second);
+    s.stats.invalidations++;
+  }
+}
+
+void cacheGetStats(cacheStats *stats) {
+  for (auto& s : shards) {
+    std::lock_guard<std::mutex> guard(s.lock);
+    stats->hits += s.stats.hits;
+    stats->misses += s.stats.misses;
+    stats->revalidations += s.stats.revalidations;
+    stats->revalidationHits += s.stats.revalidationHits;
+    stats->revalidationsRaced += s.stats.revalidationsRaced;
+    stats->inserts += s.stats.inserts;
+    stats->evictions += s.stats.evictions;
+    stats->invalidations += s.stats.invalidations;
+    stats->entries += s.stats.entries;
+    stats->bytes += s.bytes;
+  }
+}
+
+/* Append the cache section of INFO. Revalidations that found the entry
+ * unchanged count as hits, but not those that raced an invalidation. */
+void cacheInfo(std::string *info) {
+  cacheStats stats;
+  cacheGetStats(&stats);
+  uint64_t hits = stats.hits + stats.revalidationHits;
+  uint64_t lookups = stats.hits + stats.misses + stats.revalidations;
+  char buf[1024];
+  snprintf(buf, sizeof(buf),
+      "# Cache\r\n"
+      "cache_enabled:%d\r\n"
+      "cache_maxmemory:%zu\r\n"
+      "cache_ttl_ms:%llu\r\n"
+      "cache_used_memory:%llu\r\n"
+      "cache_keys:%llu\r\n"
+      "cache_hits:%llu\r\n"
+      "cache_misses:%llu\r\n"
+      "cache_revalidations:%llu\r\n"
+      "cache_revalidation_hits:%llu\r\n"
+      "cache_revalidations_raced:%llu\r\n"
+      "cache_hit_ratio:%.4f\r\n"
+      "cache_inserts:%llu\r\n"
+      "cache_evictions:%llu\r\n"
+      "cache_invalidations:%llu\r\n",
+      cacheEnabled() ? 1 : 0,
+      shardBytes * CACHE_SHARDS,
+      (unsigned long long)ttlMs,
+      (unsigned long long)stats.bytes,
+      (unsigned long long)stats.entries,
+      (unsigned long long)stats.hits,
+      (unsigned long long)stats.misses,
+      (unsigned long long)stats.revalidations,
+      (unsigned long long)stats.revalidationHits,
+      (unsigned long long)stats.revalidationsRaced,
+      lookups ? (double)hits / lookups : 0.0,
+      (unsigned long long)stats.inserts,
+      (unsigned long long)stats.evictions,
+      (unsigned long long)stats.invalidations);
+  info->append(buf);
+}
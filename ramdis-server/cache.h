@@ -0,0 +1,80 @@
+#ifndef __CACHE_H
+#define __CACHE_H
+
+#include <stdint.h>
+#include <memory>
+#include <string>
+
+#include "ramdis-server.h"
+
+/* Near cache of GET replies, shared by all executors. Entries hold the bulk
+ * reply to GET key already encoded as RESP, along with the RAMCloud version of
+ * the object it was read from. A hit hands out a reference to the reply, so
+ * the shard lock is not held for a copy of it. Keys are spread over CACHE_SHARDS shards, each
+ * with its own lock and an equal share of the size limit.
+ *
+ * Eviction is CLOCK with a small saturating use count instead of a reference
+ * bit: the hand decrements the counts of the entries it passes and evicts the
+ * first one at zero, so keys hit often survive a few sweeps and keys read only
+ * once go first.
+ *
+ * Writes made through this server invalidate the keys they touch once they
+ * are done. A read that was already under way when that happened might carry
+ * the old value, so every invalidation bumps its shard's epoch, and an insert
+ * is dropped if the epoch changed since the lookup that missed. Writes made
+ * through other servers are only noticed once an entry is older than the TTL:
+ * it is then revalidated against RAMCloud with a read that is rejected if the
+ * version is unchanged, which costs a round trip but no value transfer. */
+
+#define CACHE_SHARDS 64
+#define CACHE_USE_MAX 3 /* Sweeps a hot entry survives. */
+/* Rough per entry cost of the map and entry itself, counted against the size
+ * limit along with the key and reply. */
+#define CACHE_ENTRY_OVERHEAD 96
+
+/* Results of cacheLookup(). */
+#define CACHE_MISS 0
+#define CACHE_HIT 1
+#define CACHE_STALE 2 /* Cached, but needs revalidating first. */
+
+/* What a lookup found out about a key. */
+struct cacheProbe {
+  cacheProbe() : result(CACHE_MISS), version(0), epoch(0), reply() {}
+  int result;
+  uint64_t version;     /* Version the cached reply was read at. */
+  uint64_t epoch;       /* Epoch of the key's shard at the time. */
+  /* The cached reply, unless a miss. Shared with the entry, which may be
+   * evicted or replaced while the probe still holds it. */
+  std::shared_ptr<const std::string> reply;
+};
+
+/* Counters, summed over the shards. */
+struct cacheStats {
+  cacheStats() : hits(0), misses(0), revalidations(0), revalidationHits(0),
+    revalidationsRaced(0), inserts(0), evictions(0), invalidations(0),
+    entries(0), bytes(0) {}
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t revalidations;    /* Lookups of stale entries. */
+  uint64_t revalidationHits; /* Stale entries found to be unchanged. */
+  /* Stale entries found to be unchanged, but only after the key was
+   * invalidated, so they could not be kept. */
+  uint64_t revalidationsRaced;
+  uint64_t inserts;
+  uint64_t evictions;
+  uint64_t invalidations;
+  uint64_t entries;
+  uint64_t bytes;
+};
+
+void cacheInit(size_t maxBytes, uint64_t ttl);
+bool cacheEnabled();
+void cacheLookup(const argView &key, cacheProbe *probe);
+void cacheInsert(const argView &key, const cacheProbe &probe,
+    const char *reply, size_t len, uint64_t version);
+void cacheRevalidated(const argView &key, const cacheProbe &probe);
+void cacheInvalidate(const argView &key);
+void cacheGetStats(cacheStats *stats);
+void cacheInfo(std::string *info);
+
+#endif // __CACHE_H
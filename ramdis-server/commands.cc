@@ -1,345 +1,1061 @@
 #include <string>
-#include <sstream>
 #include <vector>
+#include <deque>
+#include <algorithm>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <string.h>
+#include <ctype.h>
+#include <limits.h>
 
 #include "commands.h"
+#include "list.h"
+#include "cache.h"
+#include "latency.h"
 #include "RamCloud.h"
 #include "ClientException.h"
+#include "Status.h"
+#include "Transaction.h"
+#include "../PerfUtils/TimeTrace.h"
 
-std::string unsupportedCommand(RAMCloud::RamCloud *client,
-    uint64_t tableId,
-    std::vector<std::string> *argv) {
-  std::string res("+Unsupported command.\r\n");
-  return res;
+void unsupportedCommand(commandContext *c) {
+  addReplyError(c->reply, "Unsupported command.");
 }
 
-std::string getCommand(RAMCloud::RamCloud *client,
-    uint64_t tableId,
-    std::vector<std::string> *argv) {
-  RAMCloud::Buffer buffer;
-  try {
-    client->read(tableId, (*argv)[1].c_str(),
-        (*argv)[1].length(), &buffer);
-    std::stringstream ss;
-    ss << "$" << buffer.size();
-    const char* data = static_cast<const char*>(buffer.getRange(0,
-            buffer.size()));
-    ss.write(data, buffer.size());
-    ss << "\r\n";
-    return ss.str();
-  } catch (RAMCloud::ObjectDoesntExistException& e) {
-    std::string res("+Unknown key.\r\n");
-    return res;
+/* CLIENT LIST. Shows how many requests each client has waiting in its
+ * pipeline, ready to dispatch, and in flight, from snapshots the reactors
+ * take for it. */
+void clientCommand(commandContext *c) {
+  std::string sub = (*c->argv)[1].str();
+  std::transform(sub.begin(), sub.end(), sub.begin(), ::tolower);
+  if (sub != "list" || c->argv->size() != 2) {
+    addReplyError(c->reply, "Syntax error, try CLIENT LIST");
+    return;
   }
+
+  std::string list;
+  clientList(&list);
+  addReplyBulk(c->reply, list.data(), list.size());
 }
 
-std::string incrCommand(RAMCloud::RamCloud *client,
-    uint64_t tableId,
-    std::vector<std::string> *argv) {
-  try {
-    uint64_t newValue = client->incrementInt64(tableId, (*argv)[1].c_str(),
-        (*argv)[1].length(), 1);
-    std::stringstream ss;
-    ss << ":" << newValue;
-    ss << "\r\n";
-    return ss.str();
-  } catch (RAMCloud::ObjectDoesntExistException& e) {
-    std::string res("+Unknown key.\r\n");
-    return res;
+/* DEBUG TIMETRACE [RESET]. Returns the time trace, which --trace-sample
+ * fills with the stage times of sampled requests, or empties it. */
+void debugCommand(commandContext *c) {
+  std::string sub = (*c->argv)[1].str();
+  std::transform(sub.begin(), sub.end(), sub.begin(), ::tolower);
+  if (sub != "timetrace" || c->argv->size() > 3) {
+    addReplyError(c->reply, "Syntax error, try DEBUG TIMETRACE [RESET]");
+    return;
+  }
+
+  if (c->argv->size() == 3) {
+    std::string arg = (*c->argv)[2].str();
+    std::transform(arg.begin(), arg.end(), arg.begin(), ::tolower);
+    if (arg != "reset") {
+      addReplyError(c->reply, "Syntax error, try DEBUG TIMETRACE [RESET]");
+      return;
+    }
+    PerfUtils::TimeTrace::reset();
+    addReplyStatus(c->reply, "OK");
+    return;
   }
+
+  std::string trace = PerfUtils::TimeTrace::getTrace();
+  addReplyBulk(c->reply, trace.data(), trace.size());
 }
 
-std::string setCommand(RAMCloud::RamCloud *client,
-    uint64_t tableId,
-    std::vector<std::string> *argv) {
-  client->write(tableId, (*argv)[1].c_str(),
-      (*argv)[1].length(),
-      (*argv)[2].c_str());
-  return std::string("+OK\r\n");
+/* SLOWLOG GET [count] | LEN | RESET. Entries have the six fields of Redis,
+ * where the duration is the execution time, and then the time of each stage
+ * as name and microseconds. */
+void slowlogCommand(commandContext *c) {
+  static const char *stageNames[NUM_STAGES] =
+      {"dispatch", "queue", "execute", "reply", "total"};
+  std::string sub = (*c->argv)[1].str();
+  std::transform(sub.begin(), sub.end(), sub.begin(), ::tolower);
+  size_t argc = c->argv->size();
+
+  if (sub == "len" && argc == 2) {
+    addReplyLongLong(c->reply, slowlogLength());
+  } else if (sub == "reset" && argc == 2) {
+    slowlogReset();
+    addReplyStatus(c->reply, "OK");
+  } else if (sub == "get" && argc <= 3) {
+    long long count = 10;
+    if (argc == 3 && (!string2ll((*c->argv)[2].data(),
+            (*c->argv)[2].length(), &count) || count < -1)) {
+      addReplyError(c->reply, "count should be greater than or equal to -1");
+      return;
+    }
+
+    std::vector<std::shared_ptr<const slowlogEntry>> entries;
+    slowlogEntries(&entries);
+    if (count != -1 && entries.size() > (size_t)count)
+      entries.resize(count);
+
+    addReplyArrayLen(c->reply, entries.size());
+    for (auto const& entry : entries) {
+      addReplyArrayLen(c->reply, 7);
+      addReplyLongLong(c->reply, entry->id);
+      addReplyLongLong(c->reply, entry->time);
+      addReplyLongLong(c->reply, entry->stages[STAGE_EXECUTE]);
+      addReplyArrayLen(c->reply, entry->argv.size());
+      for (auto const& arg : entry->argv)
+        addReplyBulk(c->reply, arg.data(), arg.size());
+      addReplyBulk(c->reply, entry->addr.data(), entry->addr.size());
+      addReplyBulk(c->reply, "", 0);
+      addReplyArrayLen(c->reply, 2 * NUM_STAGES);
+      for (int i = 0; i < NUM_STAGES; i++) {
+        addReplyBulk(c->reply, stageNames[i], strlen(stageNames[i]));
+        addReplyLongLong(c->reply, entry->stages[i]);
+      }
+    }
+  } else {
+    addReplyError(c->reply, "Syntax error, try SLOWLOG GET [count], "
+        "SLOWLOG LEN or SLOWLOG RESET");
+  }
 }
 
-std::string lpushCommand(RAMCloud::RamCloud *client,
-    uint64_t tableId,
-    std::vector<std::string> *argv) {
-  
-  // Arg validation.
-  if ((*argv)[2].length() >= (1 << (sizeof(uint16_t)*8))) {
-    std::string res("+List element must be less than 64KB in size.\r\n");
-    return res;
+/* LATENCY LATEST | HISTORY event | RESET [event ...] | DOCTOR. */
+void latencyCommand(commandContext *c) {
+  std::string sub = (*c->argv)[1].str();
+  std::transform(sub.begin(), sub.end(), sub.begin(), ::tolower);
+  size_t argc = c->argv->size();
+
+  if (sub == "latest" && argc == 2) {
+    std::vector<int> events;
+    latencySample latest[LATENCY_NUM_EVENTS];
+    uint64_t max[LATENCY_NUM_EVENTS];
+    for (int i = 0; i < LATENCY_NUM_EVENTS; i++) {
+      if (latencyLatest(i, &latest[i], &max[i]))
+        events.push_back(i);
+    }
+    addReplyArrayLen(c->reply, events.size());
+    for (int i : events) {
+      const char *name = latencyEventName(i);
+      addReplyArrayLen(c->reply, 4);
+      addReplyBulk(c->reply, name, strlen(name));
+      addReplyLongLong(c->reply, latest[i].time);
+      addReplyLongLong(c->reply, latest[i].latency);
+      addReplyLongLong(c->reply, max[i]);
+    }
+  } else if (sub == "history" && argc == 3) {
+    std::vector<latencySample> samples;
+    int event = latencyEventByName((*c->argv)[2].str());
+    if (event != -1)
+      latencyHistory(event, &samples);
+    addReplyArrayLen(c->reply, samples.size());
+    for (auto const& s : samples) {
+      addReplyArrayLen(c->reply, 2);
+      addReplyLongLong(c->reply, s.time);
+      addReplyLongLong(c->reply, s.latency);
+    }
+  } else if (sub == "reset") {
+    int resets = 0;
+    for (int i = 0; i < LATENCY_NUM_EVENTS; i++) {
+      bool named = argc == 2;
+      for (size_t j = 2; j < argc && !named; j++)
+        named = (*c->argv)[j].str() == latencyEventName(i);
+      if (named && latencyReset(i))
+        resets++;
+    }
+    addReplyLongLong(c->reply, resets);
+  } else if (sub == "doctor" && argc == 2) {
+    std::string report;
+    latencyDoctor(&report);
+    addReplyBulk(c->reply, report.data(), report.size());
+  } else {
+    addReplyError(c->reply, "Syntax error, try LATENCY LATEST, "
+        "LATENCY HISTORY event, LATENCY RESET [event ...] or LATENCY DOCTOR");
   }
+}
 
-  // Read out old list, if it exists.
-  RAMCloud::Buffer buffer;
-  bool listExists = true;
-  try {
-    client->read(tableId, (*argv)[1].c_str(),
-        (*argv)[1].length(), &buffer);
-  } catch (RAMCloud::ObjectDoesntExistException& e) {
-    listExists = false;
+/* INFO [section]. Only the sections ramdis-server has something to say about
+ * are there, and an unknown section gives an empty reply, as in Redis. As
+ * there, commandstats and latencystats are only in "all", not the default. */
+void infoCommand(commandContext *c) {
+  if (c->argv->size() > 2) {
+    addReplyError(c->reply, "syntax error");
+    return;
   }
 
-  // Append new element to list.
-  size_t newListSize;
-  uint16_t elementLength = (uint16_t)(*argv)[2].length();
-  if (listExists) {
-    newListSize = sizeof(uint16_t) + elementLength + buffer.size();
-  } else {
-    newListSize = sizeof(uint16_t) + elementLength;
+  std::string section = c->argv->size() == 2 ?
+      (*c->argv)[1].str() : "default";
+  std::transform(section.begin(), section.end(), section.begin(), ::tolower);
+  bool everything = section == "all";
+  bool all = everything || section == "default";
+
+  std::string info;
+  if (all || section == "cache")
+    cacheInfo(&info);
+  if (all || section == "lanes") {
+    if (!info.empty())
+      info.append("\r\n");
+    lanesInfo(&info);
+  }
+  if (all || section == "stages") {
+    if (!info.empty())
+      info.append("\r\n");
+    stagesInfo(&info);
+  }
+  if (all || section == "admission") {
+    if (!info.empty())
+      info.append("\r\n");
+    admissionInfo(&info);
   }
+  if (everything || section == "commandstats") {
+    if (!info.empty())
+      info.append("\r\n");
+    commandStatsInfo(&info);
+  }
+  if (everything || section == "latencystats") {
+    if (!info.empty())
+      info.append("\r\n");
+    latencyStatsInfo(&info);
+  }
+  addReplyBulk(c->reply, info.data(), info.size());
+}
 
-  char* newList = (char*)malloc(newListSize);
-  memcpy(newList, &elementLength, sizeof(uint16_t));
-  memcpy(newList + sizeof(uint16_t), (*argv)[2].c_str(), elementLength);
+/* Whether a value read from RAMCloud is a string, rather than a list. */
+static bool isString(const char *data, uint32_t length) {
+  return length >= sizeof(ObjectMetadata) &&
+      ((const ObjectMetadata*)data)->type == REDIS_STRING;
+}
 
-  if (listExists) {
-    const char* oldList = static_cast<const char*>(buffer.getRange(0,
-            buffer.size()));
-    memcpy(newList + sizeof(uint16_t) + elementLength, oldList, buffer.size());
+/* Reply with a string value as it is stored, without its header, or with a
+ * WRONGTYPE error if the value is not a string. Returns true if it was. */
+static bool addReplyStoredString(commandContext *c, const char *data,
+    uint32_t length) {
+  if (!isString(data, length)) {
+    addReplyError(c->reply, WRONGTYPE_ERR);
+    return false;
   }
+  addReplyBulk(c->reply, data + sizeof(ObjectMetadata),
+      length - sizeof(ObjectMetadata));
+  return true;
+}
 
-  // Write new list.
-  client->write(tableId, 
-      (*argv)[1].c_str(),
-      (*argv)[1].length(),
-      newList, 
-      newListSize);
+/* Append a string value to c->writeValues as it is stored, behind an
+ * ObjectMetadata header. */
+static void encodeString(commandContext *c, const char *data, size_t length) {
+  ObjectMetadata meta;
+  meta.type = REDIS_STRING;
+  c->writeValues.append((const char*)&meta, sizeof(meta));
+  c->writeValues.append(data, length);
+}
 
-  // Count number of elements in the new list.
-  uint32_t pos = 0;
-  uint32_t count = 0;
-  while (pos < newListSize) {
-    count++;
-    uint16_t len = *(uint16_t*)(newList + pos);
-    pos += sizeof(uint16_t) + len;
+/* Add a key to the next MultiRead. Its value is read into the next free
+ * slot of readValues. */
+static void addMultiReadObject(commandContext *c, const argView &key) {
+  if (!c->readValues)
+    c->readValues.reset(
+        new RAMCloud::Tub<RAMCloud::ObjectBuffer>[REQUEST_BATCH_MAX]);
+
+  size_t i = c->readObjects.size();
+  c->readObjects.emplace_back(c->tableId, key.data(), key.length(),
+      &c->readValues[i]);
+}
+
+/* Read the keys added with addMultiReadObject() with a single MultiRead.
+ * RAMCloud sends one RPC per master the keys live on. */
+static void startMultiRead(commandContext *c) {
+  for (auto& object : c->readObjects)
+    c->readRequests.push_back(&object);
+
+  c->multiRead.construct(c->client, c->readRequests.data(),
+      c->readRequests.size());
+  c->multiOp = c->multiRead.get();
+}
+
+/* Reply with the value the i-th object of a finished MultiRead read, or nil
+ * if there is no such key. A key that holds something else than a string is
+ * a WRONGTYPE error, or nil too if nilIfNotString is set, as in MGET. Returns
+ * true if the reply is a string value. */
+static bool addReplyMultiReadValue(commandContext *c, size_t i,
+    bool nilIfNotString) {
+  RAMCloud::MultiReadObject &object = c->readObjects[i];
+  if (object.status == RAMCloud::STATUS_OBJECT_DOESNT_EXIST) {
+    addReplyNull(c->reply);
+    return false;
+  }
+  if (object.status != RAMCloud::STATUS_OK) {
+    addReplyErrorFormat(c->reply, "RAMCloud: %s",
+        RAMCloud::statusToString(object.status));
+    return false;
   }
 
-  free(newList);
-  
-  std::ostringstream oss;
-  oss << ":" << count << "\r\n";
+  uint32_t length;
+  const char *data = static_cast<const char*>(
+      c->readValues[i]->getValue(&length));
+  if (nilIfNotString && !isString(data, length)) {
+    addReplyNull(c->reply);
+    return false;
+  }
+  return addReplyStoredString(c, data, length);
+}
 
-  return oss.str();
+/* Reply with a cached reply. */
+static void addReplyCached(commandContext *c, const cacheProbe &probe) {
+  addReplyString(c->reply, probe.reply->data(), probe.reply->size());
 }
 
-std::string rpushCommand(RAMCloud::RamCloud *client,
-    uint64_t tableId,
-    std::vector<std::string> *argv) {
-  
-  // Arg validation.
-  if ((*argv)[2].length() >= (1 << (sizeof(uint16_t)*8))) {
-    std::string res("+List element must be less than 64KB in size.\r\n");
-    return res;
+void getBatchReply(commandContext *c) {
+  c->multiRead->wait();
+  size_t j = 0;
+  for (uint32_t i = 0; i < c->req.batchSize; i++) {
+    if (!c->probes.empty() && c->probes[i].result == CACHE_HIT) {
+      addReplyCached(c, c->probes[i]);
+      continue;
+    }
+
+    size_t start = c->reply->buf.size();
+    if (addReplyMultiReadValue(c, j, false) && !c->probes.empty()) {
+      cacheInsert((*c->argv)[i * 2 + 1], c->probes[i],
+          c->reply->buf.data() + start, c->reply->buf.size() - start,
+          c->readObjects[j].version);
+    }
+    j++;
   }
+  c->cancelRpc();
+}
 
-  // Read out old list, if it exists.
-  RAMCloud::Buffer buffer;
-  bool listExists = true;
-  try {
-    client->read(tableId, (*argv)[1].c_str(),
-        (*argv)[1].length(), &buffer);
-  } catch (RAMCloud::ObjectDoesntExistException& e) {
-    listExists = false;
-  }
-
-  // Append new element to list.
-  size_t newListSize;
-  uint16_t elementLength = (uint16_t)(*argv)[2].length();
-  char* newList;
-  if (listExists) {
-    newListSize = sizeof(uint16_t) + elementLength + buffer.size();
-    newList = (char*)malloc(newListSize);
-    const char* oldList = static_cast<const char*>(buffer.getRange(0,
-            buffer.size()));
-    memcpy(newList, oldList, buffer.size());
-    memcpy(newList + buffer.size(), &elementLength, sizeof(uint16_t));
-    memcpy(newList + buffer.size() + sizeof(uint16_t), (*argv)[2].c_str(), 
-        elementLength);
+/* A run of pipelined GETs. Only the keys that are not cached are read, with
+ * one MultiRead. Stale entries are simply read again, since a MultiRead can't
+ * be told to skip values that haven't changed. */
+static void getBatchCommand(commandContext *c) {
+  uint32_t n = c->req.batchSize;
+  if (cacheEnabled()) {
+    c->probes.resize(n);
+    for (uint32_t i = 0; i < n; i++) {
+      cacheLookup((*c->argv)[i * 2 + 1], &c->probes[i]);
+      if (c->probes[i].result != CACHE_HIT)
+        addMultiReadObject(c, (*c->argv)[i * 2 + 1]);
+    }
+    if (c->readObjects.empty()) {
+      for (auto const& probe : c->probes)
+        addReplyCached(c, probe);
+      return;
+    }
   } else {
-    newListSize = sizeof(uint16_t) + elementLength;
-    newList = (char*)malloc(newListSize);
-    memcpy(newList, &elementLength, sizeof(uint16_t));
-    memcpy(newList + sizeof(uint16_t), (*argv)[2].c_str(), elementLength);
-  }
-
-  // Write new list.
-  client->write(tableId, 
-      (*argv)[1].c_str(),
-      (*argv)[1].length(),
-      newList, 
-      newListSize);
-
-  // Count number of elements in the new list.
-  uint32_t pos = 0;
-  uint32_t count = 0;
-  while (pos < newListSize) {
-    count++;
-    uint16_t len = *(uint16_t*)(newList + pos);
-    pos += sizeof(uint16_t) + len;
-  }
-  
-  free(newList);
-
-  std::ostringstream oss;
-  oss << ":" << count << "\r\n";
-
-  return oss.str();
-}
-
-std::string lpopCommand(RAMCloud::RamCloud *client,
-    uint64_t tableId,
-    std::vector<std::string> *argv) {
-  
-  // Read out list.
-  RAMCloud::Buffer buffer;
+    for (uint32_t i = 0; i < n; i++)
+      addMultiReadObject(c, (*c->argv)[i * 2 + 1]);
+  }
+
+  startMultiRead(c);
+  c->cont = getBatchReply;
+}
+
+void getCommandReply(commandContext *c) {
+  argView &key = (*c->argv)[1];
+  uint64_t version;
   try {
-    client->read(tableId, (*argv)[1].c_str(),
-        (*argv)[1].length(), &buffer);
+    c->readRpc->wait(&version);
   } catch (RAMCloud::ObjectDoesntExistException& e) {
-    return std::string("+Unknown key.");
+    c->readRpc.destroy();
+    if (!c->probes.empty() && c->probes[0].result == CACHE_STALE)
+      cacheInvalidate(key);
+    addReplyNull(c->reply);
+    return;
+  } catch (RAMCloud::WrongVersionException& e) {
+    /* Only a revalidation can be rejected: the cached reply still holds. */
+    c->readRpc.destroy();
+    cacheRevalidated(key, c->probes[0]);
+    addReplyCached(c, c->probes[0]);
+    return;
   }
+  c->readRpc.destroy();
 
-  if (buffer.size() == 0) {
-    return std::string("$-1\r\n");
+  size_t start = c->reply->buf.size();
+  const char* data = static_cast<const char*>(c->value.getRange(0,
+          c->value.size()));
+  bool string = addReplyStoredString(c, data, c->value.size());
+  c->value.reset();
+  if (string && !c->probes.empty()) {
+    cacheInsert(key, c->probes[0], c->reply->buf.data() + start,
+        c->reply->buf.size() - start, version);
   }
+}
 
-  const char* list = static_cast<const char*>(buffer.getRange(0, 
-        buffer.size()));
-  uint16_t len = *(uint16_t*)(list);
-  std::string element(list + sizeof(uint16_t), len);
-
-  size_t newListSize = buffer.size() - sizeof(uint16_t) - len;
-  char* newList = (char*)malloc(newListSize);
-  memcpy(newList, list + sizeof(uint16_t) + len, newListSize);
-  
+/* GET key. Answered from the near cache if it is enabled and has the key.
+ * A stale entry is revalidated with a read that RAMCloud rejects if the
+ * object is still at the cached version. */
+void getCommand(commandContext *c) {
+  if (c->req.batchSize > 1) {
+    getBatchCommand(c);
+    return;
+  }
 
-  // Write new list.
-  client->write(tableId, 
-      (*argv)[1].c_str(),
-      (*argv)[1].length(),
-      newList, 
-      newListSize);
+  argView &key = (*c->argv)[1];
+  RAMCloud::RejectRules *rejectRules = NULL;
+  if (cacheEnabled()) {
+    c->probes.resize(1);
+    cacheProbe &probe = c->probes[0];
+    cacheLookup(key, &probe);
+    if (probe.result == CACHE_HIT) {
+      addReplyCached(c, probe);
+      return;
+    }
+    if (probe.result == CACHE_STALE) {
+      memset(&c->rejectRules, 0, sizeof(c->rejectRules));
+      c->rejectRules.givenVersion = probe.version;
+      c->rejectRules.doesntExist = 1;
+      c->rejectRules.versionLeGiven = 1;
+      rejectRules = &c->rejectRules;
+    }
+  }
 
-  free(newList);
+  c->readRpc.construct(c->client, c->tableId, key.data(), key.length(),
+      &c->value, rejectRules);
+  c->rpc = c->readRpc.get();
+  c->cont = getCommandReply;
+}
 
-  std::ostringstream oss;
-  oss << "+" << element << "\r\n";
+void incrCommandReply(commandContext *c) {
+  try {
+    c->writeRpc->wait();
+  } catch (RAMCloud::RejectRulesException& e) {
+    /* The key changed since it was read: start over. */
+    c->cancelRpc();
+    incrCommand(c);
+    return;
+  }
+  c->writeRpc.destroy();
 
-  return oss.str();
+  long long value;
+  string2ll(c->writeValues.data() + sizeof(ObjectMetadata),
+      c->writeValues.size() - sizeof(ObjectMetadata), &value);
+  c->writeValues.clear();
+  addReplyLongLong(c->reply, value);
 }
 
-std::string rpopCommand(RAMCloud::RamCloud *client,
-    uint64_t tableId,
-    std::vector<std::string> *argv) {
-  
-  // Read out list.
-  RAMCloud::Buffer buffer;
+void incrCommandWrite(commandContext *c) {
+  uint64_t version;
+  long long value = 0;
+  memset(&c->rejectRules, 0, sizeof(c->rejectRules));
   try {
-    client->read(tableId, (*argv)[1].c_str(),
-        (*argv)[1].length(), &buffer);
+    c->readRpc->wait(&version);
+    c->rejectRules.givenVersion = version;
+    c->rejectRules.versionNeGiven = 1;
   } catch (RAMCloud::ObjectDoesntExistException& e) {
-    return std::string("+Unknown key.");
+    c->rejectRules.exists = 1;
+  }
+  c->readRpc.destroy();
+
+  if (!c->rejectRules.exists) {
+    uint32_t length = c->value.size();
+    const char *data = static_cast<const char*>(c->value.getRange(0, length));
+    if (!isString(data, length)) {
+      addReplyError(c->reply, WRONGTYPE_ERR);
+      c->value.reset();
+      return;
+    }
+    if (!string2ll(data + sizeof(ObjectMetadata),
+          length - sizeof(ObjectMetadata), &value)) {
+      addReplyError(c->reply, "value is not an integer or out of range");
+      c->value.reset();
+      return;
+    }
+    c->value.reset();
+  }
+  if (value == LLONG_MAX) {
+    addReplyError(c->reply, "increment or decrement would overflow");
+    return;
+  }
+
+  char buf[32];
+  int len = ll2string(buf, sizeof(buf), value + 1);
+  encodeString(c, buf, len);
+  c->writeRpc.construct(c->client, c->tableId, (*c->argv)[1].data(),
+      (*c->argv)[1].length(), c->writeValues.data(), c->writeValues.size(),
+      &c->rejectRules);
+  c->rpc = c->writeRpc.get();
+  c->cont = incrCommandReply;
+}
+
+/* INCR key. RAMCloud can only increment values that are bare 8 byte
+ * integers, which strings with a header are not, so the value is read and
+ * the incremented one written back on the condition that the key hasn't
+ * changed in between. If it has, the INCR starts over. */
+void incrCommand(commandContext *c) {
+  c->readRpc.construct(c->client, c->tableId, (*c->argv)[1].data(),
+      (*c->argv)[1].length(), &c->value);
+  c->rpc = c->readRpc.get();
+  c->cont = incrCommandWrite;
+}
+
+void setCommandReply(commandContext *c) {
+  c->writeRpc->wait();
+  c->writeRpc.destroy();
+  c->writeValues.clear();
+  addReplyStatus(c->reply, "OK");
+}
+
+/* Add a key value pair to the next MultiWrite. The value is stored in
+ * c->writeValues, which may still move as more are added, so it is only
+ * pointed to by startMultiWrite(). */
+static void addMultiWriteObject(commandContext *c, const argView &key,
+    const argView &value) {
+  encodeString(c, value.data(), value.length());
+  c->writeObjects.emplace_back(c->tableId, key.data(), key.length(),
+      (const void*)NULL, sizeof(ObjectMetadata) + value.length());
+}
+
+/* Write the objects added with addMultiWriteObject() with a single
+ * MultiWrite. */
+static void startMultiWrite(commandContext *c) {
+  const char *value = c->writeValues.data();
+  for (auto& object : c->writeObjects) {
+    object.value = value;
+    value += object.valueLength;
+    c->writeRequests.push_back(&object);
+  }
+
+  c->multiWrite.construct(c->client, c->writeRequests.data(),
+      c->writeRequests.size());
+  c->multiOp = c->multiWrite.get();
+}
+
+void setBatchReply(commandContext *c) {
+  c->multiWrite->wait();
+  for (auto& object : c->writeObjects) {
+    if (object.status == RAMCloud::STATUS_OK)
+      addReplyStatus(c->reply, "OK");
+    else
+      addReplyErrorFormat(c->reply, "RAMCloud: %s",
+          RAMCloud::statusToString(object.status));
+  }
+  c->cancelRpc();
+}
+
+void setCommand(commandContext *c) {
+  if (c->req.batchSize > 1) {
+    for (uint32_t i = 0; i < c->req.batchSize; i++)
+      addMultiWriteObject(c, (*c->argv)[i * 3 + 1], (*c->argv)[i * 3 + 2]);
+    startMultiWrite(c);
+    c->cont = setBatchReply;
+    return;
+  }
+
+  encodeString(c, (*c->argv)[2].data(), (*c->argv)[2].length());
+  c->writeRpc.construct(c->client, c->tableId, (*c->argv)[1].data(),
+      (*c->argv)[1].length(),
+      c->writeValues.data(),
+      c->writeValues.size());
+  c->rpc = c->writeRpc.get();
+  c->cont = setCommandReply;
+}
+
+/* Keep what this step of a command added to the reply buffer aside until the
+ * step that finishes the command. */
+static void holdReply(commandContext *c) {
+  c->heldReply.append(c->reply->buf);
+  c->reply->buf.clear();
+}
+
+/* Put the reply held back by holdReply() in front of whatever this step adds
+ * next. */
+static void releaseReply(commandContext *c) {
+  c->reply->buf.append(c->heldReply);
+  c->heldReply.clear();
+}
+
+void mgetCommandReply(commandContext *c);
+
+/* Read the next chunk of at most REQUEST_BATCH_MAX keys. */
+static void mgetNextChunk(commandContext *c) {
+  size_t numKeys = c->argv->size() - 1;
+  size_t count = std::min(numKeys - c->multiNext, (size_t)REQUEST_BATCH_MAX);
+  holdReply(c);
+  for (size_t i = 0; i < count; i++)
+    addMultiReadObject(c, (*c->argv)[c->multiNext + 1 + i]);
+  startMultiRead(c);
+  c->multiNext += count;
+  c->cont = mgetCommandReply;
+}
+
+void mgetCommandReply(commandContext *c) {
+  c->multiRead->wait();
+  bool last = c->multiNext == c->argv->size() - 1;
+  if (last)
+    releaseReply(c);
+  for (size_t i = 0; i < c->readObjects.size(); i++)
+    addReplyMultiReadValue(c, i, true);
+  c->cancelRpc();
+  if (!last)
+    mgetNextChunk(c);
+}
+
+/* MGET key [key ...]. Keys are read with one MultiRead per chunk, which costs
+ * about one round trip per master the chunk's keys live on. */
+void mgetCommand(commandContext *c) {
+  addReplyArrayLen(c->reply, c->argv->size() - 1);
+  c->multiNext = 0;
+  mgetNextChunk(c);
+}
+
+void msetCommandReply(commandContext *c);
+
+/* Write the next chunk of at most REQUEST_BATCH_MAX key value pairs. A key
+ * set twice in the same chunk is only written with its last value, since
+ * RAMCloud doesn't promise to apply the writes of a MultiWrite in order. */
+static void msetNextChunk(commandContext *c) {
+  std::vector<argView> &argv = *c->argv;
+  size_t numPairs = (argv.size() - 1) / 2;
+  size_t end = std::min(numPairs, c->multiNext + REQUEST_BATCH_MAX);
+  for (size_t i = c->multiNext; i < end; i++) {
+    const argView &key = argv[i * 2 + 1];
+    bool overwritten = false;
+    for (size_t j = i + 1; j < end && !overwritten; j++) {
+      const argView &later = argv[j * 2 + 1];
+      overwritten = later.length() == key.length() &&
+          memcmp(later.data(), key.data(), key.length()) == 0;
+    }
+    if (!overwritten)
+      addMultiWriteObject(c, key, argv[i * 2 + 2]);
   }
+  c->multiNext = end;
+  startMultiWrite(c);
+  c->cont = msetCommandReply;
+}
 
-  if (buffer.size() == 0) {
-    return std::string("$-1\r\n");
+void msetCommandReply(commandContext *c) {
+  c->multiWrite->wait();
+  for (auto& object : c->writeObjects) {
+    if (object.status != RAMCloud::STATUS_OK) {
+      addReplyErrorFormat(c->reply, "RAMCloud: %s",
+          RAMCloud::statusToString(object.status));
+      c->cancelRpc();
+      return;
+    }
   }
+  c->cancelRpc();
+
+  if (c->multiNext < (c->argv->size() - 1) / 2)
+    msetNextChunk(c);
+  else
+    addReplyStatus(c->reply, "OK");
+}
+
+/* MSET key value [key value ...]. Like MGET, written one MultiWrite per
+ * chunk. Unlike in Redis the writes are not atomic: another client may see
+ * some of them before the rest. */
+void msetCommand(commandContext *c) {
+  if (c->argv->size() % 2 == 0) {
+    addReplyError(c->reply, "wrong number of arguments for MSET");
+    return;
+  }
+
+  c->multiNext = 0;
+  msetNextChunk(c);
+}
+
+/* Pushes to the same list are group committed. The first push to a key
+ * becomes the key's leader; pushes that come in before it commits, or while
+ * it is committing, queue up behind it and wait. The leader doesn't commit
+ * in its proc, but from its continuation, after the executor has filled the
+ * rest of its window, so that pushes dequeued by the same executor join the
+ * group too. That is the only grouping there is with --key-affinity, where
+ * all pushes to a list go to one executor. When the leader is done it hands
+ * the queue to the oldest waiting push, which commits all of them in one
+ * transaction. Instead of hundreds of pushes to a hot list each retrying
+ * against all the others, there is one transaction per round trip, and the
+ * rounds grow with the load. */
+#define PUSH_GROUP_SHARDS 64
+
+struct pushGroup {
+  pushGroup() : pending() {}
+  std::vector<pushOp*> pending; /* Waiting for the next commit, oldest first. */
+};
 
-  const char* list = static_cast<const char*>(buffer.getRange(0, 
-        buffer.size()));
+/* Keys that have a push being committed. */
+struct pushGroupShard {
+  pushGroupShard() : lock(), groups() {}
+  std::mutex lock;
+  std::unordered_map<std::string, pushGroup> groups;
+};
 
-  // Find last element of the list.
-  uint32_t pos = 0;
-  uint16_t len;
+static pushGroupShard pushGroups[PUSH_GROUP_SHARDS];
+
+static pushGroupShard &pushGroupShardOf(const std::string &key) {
+  return pushGroups[std::hash<std::string>()(key) % PUSH_GROUP_SHARDS];
+}
+
+/* Apply ops to the list at key in order, in one transaction, and record the
+ * length of the list after each. A push that doesn't fit fails on its own,
+ * and the rest are tried again without it. */
+static void commitPushes(commandContext *c, const argView &key,
+    const std::vector<pushOp*> &ops) {
   while (true) {
-    len = *(uint16_t*)(list + pos);
-    if (pos + sizeof(uint16_t) + len == buffer.size()) {
-      break;
+    latencyRpcTimer timer;
+    RAMCloud::Transaction tx(c->client);
+    listIndex index;
+    int status = listReadIndex(&tx, c->tableId, key, &index);
+    if (status == LIST_WRONGTYPE) {
+      for (auto op : ops)
+        op->error = WRONGTYPE_ERR;
+      return;
+    } else if (status == LIST_NOT_FOUND) {
+      index.meta.type = REDIS_LIST;
     }
-    pos += sizeof(uint16_t) + len;
+
+    bool full = false;
+    for (auto op : ops) {
+      if (!op->error.empty())
+        continue;
+      if (listPush(&tx, c->segTableId, key, &index, op->where, op->values,
+            op->count) == C_ERR) {
+        op->error = "List is full.";
+        full = true;
+        break;
+      }
+      op->length = index.length();
+    }
+    if (full)
+      continue;
+
+    listWriteIndex(&tx, c->tableId, key, index);
+    if (tx.commit())
+      return;
   }
+}
 
-  std::string element(list + pos + sizeof(uint16_t), len);
+/* Commit the pushes queued on key, c's own among them, then wake them up and
+ * hand the key to the oldest push that queued up meanwhile, if any. */
+static void commitPushGroup(commandContext *c, const argView &key) {
+  std::string k = key.str();
+  pushGroupShard &s = pushGroupShardOf(k);
+  std::vector<pushOp*> ops;
+  {
+    std::lock_guard<std::mutex> guard(s.lock);
+    ops.swap(s.groups[k].pending);
+  }
 
-  size_t newListSize = buffer.size() - sizeof(uint16_t) - len;
-  char* newList = (char*)malloc(newListSize);
-  memcpy(newList, list, newListSize);
+  /* The waiting pushes need their results no matter what. */
+  try {
+    commitPushes(c, key, ops);
+  } catch (RAMCloud::ClientException& e) {
+    for (auto op : ops)
+      op->error = std::string("RAMCloud: ") + e.str();
+  }
 
-  // Write new list.
-  client->write(tableId, 
-      (*argv)[1].c_str(),
-      (*argv)[1].length(),
-      newList, 
-      newListSize);
+  pushOp *next = NULL;
+  {
+    std::lock_guard<std::mutex> guard(s.lock);
+    auto it = s.groups.find(k);
+    if (it->second.pending.empty())
+      s.groups.erase(it);
+    else
+      next = it->second.pending.front();
+  }
+  for (auto op : ops) {
+    if (op != &c->push)
+      op->state.store(PUSH_DONE, std::memory_order_release);
+  }
+  if (next != NULL)
+    next->state.store(PUSH_LEAD, std::memory_order_release);
+}
+
+static void addReplyPush(commandContext *c) {
+  if (!c->push.error.empty())
+    addReplyError(c->reply, c->push.error.c_str());
+  else
+    addReplyLongLong(c->reply, c->push.length);
+}
 
-  free(newList);
+/* A queued push is done, or it is its turn to commit the queue. */
+void pushCommandReply(commandContext *c) {
+  if (c->push.state.load(std::memory_order_acquire) == PUSH_LEAD)
+    commitPushGroup(c, (*c->argv)[1]);
+  addReplyPush(c);
+}
 
-  std::ostringstream oss;
-  oss << "+" << element << "\r\n";
+/* LPUSH and RPUSH key element [element ...]. All the elements are added in
+ * one transaction, writing each segment they go into once. The push waits
+ * without holding up the executor, either for its turn to commit or for
+ * another push to the same list to commit it together with the others that
+ * queued up. */
+static void pushGenericCommand(commandContext *c, int where) {
+  argView &key = (*c->argv)[1];
+  for (size_t j = 2; j < c->argv->size(); j++) {
+    if ((*c->argv)[j].length() > UINT16_MAX) {
+      addReplyError(c->reply, "List element must be less than 64KB in size.");
+      return;
+    }
+  }
 
-  return oss.str();
+  c->push.where = where;
+  c->push.values = &(*c->argv)[2];
+  c->push.count = c->argv->size() - 2;
+
+  std::string k = key.str();
+  pushGroupShard &s = pushGroupShardOf(k);
+  bool lead;
+  {
+    std::lock_guard<std::mutex> guard(s.lock);
+    auto it = s.groups.find(k);
+    lead = it == s.groups.end();
+    if (lead)
+      it = s.groups.emplace(k, pushGroup()).first;
+    it->second.pending.push_back(&c->push);
+  }
+
+  if (lead)
+    c->push.state.store(PUSH_LEAD, std::memory_order_relaxed);
+  c->pushWait = &c->push;
+  c->cont = pushCommandReply;
 }
 
-std::string lrangeCommand(RAMCloud::RamCloud *client,
-    uint64_t tableId,
-    std::vector<std::string> *argv) {
+void lpushCommand(commandContext *c) {
+  pushGenericCommand(c, LIST_HEAD);
+}
 
-  int start = atoi((*argv)[2].c_str());  
-  int end = atoi((*argv)[3].c_str());
+void rpushCommand(commandContext *c) {
+  pushGenericCommand(c, LIST_TAIL);
+}
 
-  // Read out old list, if it exists.
-  RAMCloud::Buffer buffer;
+/* LPOP and RPOP. Only reads and rewrites the segment at that end. */
+static void popGenericCommand(commandContext *c, int where) {
+  argView &key = (*c->argv)[1];
+
+  while (true) {
+    latencyRpcTimer timer;
+    RAMCloud::Transaction tx(c->client);
+    listIndex index;
+    int status = listReadIndex(&tx, c->tableId, key, &index);
+    if (status == LIST_WRONGTYPE) {
+      addReplyError(c->reply, WRONGTYPE_ERR);
+      return;
+    } else if (status == LIST_NOT_FOUND || index.length() == 0) {
+      addReplyNull(c->reply);
+      return;
+    }
+
+    std::string value;
+    listPop(&tx, c->segTableId, key, &index, where, &value);
+    listWriteIndex(&tx, c->tableId, key, index);
+
+    if (tx.commit()) {
+      addReplyBulk(c->reply, value.data(), value.length());
+      return;
+    }
+  }
+}
+
+void lpopCommand(commandContext *c) {
+  popGenericCommand(c, LIST_HEAD);
+}
+
+void rpopCommand(commandContext *c) {
+  popGenericCommand(c, LIST_TAIL);
+}
+
+void llenCommandReply(commandContext *c) {
   try {
-    client->read(tableId, (*argv)[1].c_str(),
-        (*argv)[1].length(), &buffer);
+    c->readRpc->wait();
   } catch (RAMCloud::ObjectDoesntExistException& e) {
-    std::string res("+Unknown key.\r\n");
-    return res;
+    c->readRpc.destroy();
+    addReplyLongLong(c->reply, 0);
+    return;
   }
+  c->readRpc.destroy();
+
+  listIndex index;
+  if (listDecodeIndex(&c->value, &index) == LIST_OK)
+    addReplyLongLong(c->reply, index.length());
+  else
+    addReplyError(c->reply, WRONGTYPE_ERR);
+  c->value.reset();
+}
 
-  const char* list = static_cast<const char*>(buffer.getRange(0, 
-        buffer.size()));
+/* LLEN key. Adds up the element counts in the index, without reading any
+ * segments. A single read, so it doesn't need a transaction. */
+void llenCommand(commandContext *c) {
+  c->readRpc.construct(c->client, c->tableId, (*c->argv)[1].data(),
+      (*c->argv)[1].length(), &c->value);
+  c->rpc = c->readRpc.get();
+  c->cont = llenCommandReply;
+}
 
-  // Parse the elements.
-  uint32_t pos = 0;
-  std::vector<std::string> elements;
-  while (pos < buffer.size()) {
-    uint16_t len = *(uint16_t*)(list + pos);
-    pos += sizeof(uint16_t);
-    elements.emplace_back(list + pos, len);
-    pos += len;
+/* Read the index of the list at key in tx, and find element i of it, where
+ * negative indexes count from the tail. Replies and returns C_ERR if the key
+ * isn't a list, or it has no such element, in which case the reply is nil, or
+ * notFound if that isn't NULL. */
+static int locateListElement(commandContext *c, RAMCloud::Transaction *tx,
+    const argView &key, long long i, listIndex *index, size_t *seg,
+    uint32_t *pos, const char *notFound) {
+  int status = listReadIndex(tx, c->tableId, key, index);
+  if (status == LIST_WRONGTYPE) {
+    addReplyError(c->reply, WRONGTYPE_ERR);
+    return C_ERR;
   }
 
-  uint32_t startIndex;
-  if (start < 0) {
-    startIndex = elements.size() + start;
-  } else {
-    startIndex = start;
+  long long llen = status == LIST_OK ? index->length() : 0;
+  if (i < 0)
+    i += llen;
+  if (status == LIST_NOT_FOUND || i < 0 || i >= llen) {
+    if (notFound)
+      addReplyError(c->reply, notFound);
+    else
+      addReplyNull(c->reply);
+    return C_ERR;
   }
 
-  uint32_t endIndex;
-  if (end < 0) {
-    endIndex = elements.size() + end;
-  } else {
-    if (end >= elements.size()) {
-      endIndex = elements.size() - 1;
-    } else {
-      endIndex = end;
-    }
+  *seg = listLocate(*index, i, pos);
+  return C_OK;
+}
+
+/* LINDEX key index. Reads the index and the one segment holding the
+ * element. */
+void lindexCommand(commandContext *c) {
+  argView &key = (*c->argv)[1];
+  long long i;
+  if (!string2ll((*c->argv)[2].data(), (*c->argv)[2].length(), &i)) {
+    addReplyError(c->reply, "value is not an integer or out of range");
+    return;
   }
 
-  // Generate return message.
-  std::ostringstream oss;
-  uint32_t rangeSize = endIndex - startIndex + 1;
-  oss << "*" << rangeSize << "\r\n";
+  while (true) {
+    latencyRpcTimer timer;
+    RAMCloud::Transaction tx(c->client);
+    listIndex index;
+    size_t seg;
+    uint32_t pos;
+    if (locateListElement(c, &tx, key, i, &index, &seg, &pos, NULL) ==
+        C_ERR)
+      return;
+
+    RAMCloud::Buffer segment;
+    ListIndexEntry &entry = index.entries[seg];
+    listReadSegment(&tx, c->segTableId, key, entry.segId, &segment);
+    uint16_t len = listSegmentElementLength(&segment, pos);
+    uint32_t offset = listSegmentElementOffset(&segment, entry.elemCount,
+        pos);
+    std::string value;
+    value.resize(len);
+    segment.copy(offset, len, &value[0]);
 
-  uint32_t count = 0;
-  for(auto const& e: elements) {
-    if (count >= start && count <= end) {
-      oss << "$" << e.length() << "\r\n" << e << "\r\n";
+    if (tx.commit()) {
+      addReplyBulk(c->reply, value.data(), value.length());
+      return;
     }
-    count++;
   }
+}
+
+/* LSET key index value. Rewrites the segment holding the element, and the
+ * index only if the segment's size in KB changed. */
+void lsetCommand(commandContext *c) {
+  argView &key = (*c->argv)[1];
+  argView &value = (*c->argv)[3];
+  long long i;
+  if (!string2ll((*c->argv)[2].data(), (*c->argv)[2].length(), &i)) {
+    addReplyError(c->reply, "value is not an integer or out of range");
+    return;
+  }
+  if (value.length() > UINT16_MAX) {
+    addReplyError(c->reply, "List element must be less than 64KB in size.");
+    return;
+  }
+
+  while (true) {
+    latencyRpcTimer timer;
+    RAMCloud::Transaction tx(c->client);
+    listIndex index;
+    size_t seg;
+    uint32_t pos;
+    if (locateListElement(c, &tx, key, i, &index, &seg, &pos,
+          "index out of range") == C_ERR)
+      return;
 
-  return oss.str();
+    if (listSet(&tx, c->segTableId, key, &index, seg, pos, value))
+      listWriteIndex(&tx, c->tableId, key, index);
+
+    if (tx.commit()) {
+      addReplyStatus(c->reply, "OK");
+      return;
+    }
+  }
 }
 
+/* LRANGE key start stop. Reads the segments that overlap the range all at
+ * once, in a transaction so that they and the index are from the same version
+ * of the list, and encodes the elements in the range straight out of them.
+ * Big replies are handed to the reactor REPLY_BUFFER_SIZE at a time, so that
+ * the first part is on its way to the client while the rest is encoded.
+ *
+ * Nothing goes out before the transaction commits, so streaming only starts
+ * once every segment has been read. A segment that changed under the read
+ * fails the commit, and the whole range is read again; a part of the reply
+ * already sent from the old version could not be taken back. */
+void lrangeCommand(commandContext *c) {
+  argView &key = (*c->argv)[1];
+  long long start, end;
+  if (!string2ll((*c->argv)[2].data(), (*c->argv)[2].length(), &start) ||
+      !string2ll((*c->argv)[3].data(), (*c->argv)[3].length(), &end)) {
+    addReplyError(c->reply, "value is not an integer or out of range");
+    return;
+  }
+
+  while (true) {
+    latencyRpcTimer timer;
+    RAMCloud::Transaction tx(c->client);
+    listIndex index;
+    int status = listReadIndex(&tx, c->tableId, key, &index);
+    if (status == LIST_WRONGTYPE) {
+      addReplyError(c->reply, WRONGTYPE_ERR);
+      return;
+    } else if (status == LIST_NOT_FOUND) {
+      addReplyArrayLen(c->reply, 0);
+      return;
+    }
+
+    /* Convert negative indexes, and clamp the range to the list. */
+    long long llen = index.length();
+    long long first = start < 0 ? llen + start : start;
+    long long last = end < 0 ? llen + end : end;
+    if (first < 0) first = 0;
+    if (last >= llen) last = llen - 1;
+    if (first > last) {
+      addReplyArrayLen(c->reply, 0);
+      return;
+    }
+
+    /* Batched reads go out together when the first of them is waited on. */
+    uint32_t firstPos, lastPos;
+    size_t firstSeg = listLocate(index, first, &firstPos);
+    size_t lastSeg = listLocate(index, last, &lastPos);
+    std::deque<std::string> segKeys;
+    std::deque<RAMCloud::Buffer> segments;
+    std::deque<RAMCloud::Transaction::ReadOp> reads;
+    for (size_t seg = firstSeg; seg <= lastSeg; seg++) {
+      segKeys.push_back(listSegmentKey(key, index.entries[seg].segId));
+      segments.emplace_back();
+      reads.emplace_back(&tx, c->segTableId, segKeys.back().data(),
+          segKeys.back().size(), &segments.back(), true);
+    }
+    for (auto& read : reads)
+      read.wait();
+
+    if (!tx.commit())
+      continue;
+    timer.stop();
+
+    addReplyArrayLen(c->reply, last - first + 1);
+    long long i = first - firstPos;
+    for (size_t seg = firstSeg; seg <= lastSeg; seg++) {
+      RAMCloud::Buffer &segment = segments[seg - firstSeg];
+      uint32_t elemCount = index.entries[seg].elemCount;
+      uint32_t offset = elemCount * sizeof(uint16_t);
+      for (uint32_t j = 0; j < elemCount && i <= last; j++, i++) {
+        uint16_t len = listSegmentElementLength(&segment, j);
+        if (i >= first) {
+          addReplyBulk(c->reply, static_cast<const char*>(
+                segment.getRange(offset, len)), len);
+        }
+        offset += len;
+      }
+      if (c->reply->buf.size() >= REPLY_BUFFER_SIZE)
+        sendPartialResponse(&c->req, takeReply(c->reply));
+    }
+    return;
+  }
+}
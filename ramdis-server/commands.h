@@ -1,42 +1,203 @@
 #ifndef __COMMANDS_H
 #define __COMMANDS_H
 
+#include "ramdis-server.h"
+#include "reply.h"
+#include "cache.h"
+#include "admission.h"
+#include "commandstats.h"
 #include "RamCloud.h"
+#include "MultiRead.h"
+#include "MultiWrite.h"
 
-std::string unsupportedCommand(RAMCloud::RamCloud *, 
-    uint64_t,
-    std::vector<std::string> *argv);
+struct commandContext;
 
-std::string getCommand(RAMCloud::RamCloud *, 
-    uint64_t,
-    std::vector<std::string> *argv);
+/* States of a pushOp. */
+#define PUSH_WAITING 0
+#define PUSH_DONE 1
+#define PUSH_LEAD 2     /* Its turn to commit the pushes queued on its key. */
 
-std::string incrCommand(RAMCloud::RamCloud *, 
-    uint64_t,
-    std::vector<std::string> *argv);
+/* An LPUSH or RPUSH waiting to be committed along with the other pushes to
+ * the same list, see pushGenericCommand(). Whoever commits it fills in the
+ * result and then sets state, so the result may be read once state is not
+ * PUSH_WAITING. */
+struct pushOp {
+  pushOp() : where(0), values(NULL), count(0), length(0), error(),
+    state(PUSH_WAITING) {}
+  int where;
+  const argView *values;
+  size_t count;
+  long long length;     /* Length of the list right after this push. */
+  std::string error;    /* Error to reply with instead, if not empty. */
+  std::atomic<int> state;
+};
 
-std::string setCommand(RAMCloud::RamCloud *, 
-    uint64_t,
-    std::vector<std::string> *argv);
+/* Called once the RPC a command is waiting on is ready. Adds the reply,
+ * unless it starts another RPC, in which case it is called again. */
+typedef void commandCont(commandContext *c);
 
-std::string lpushCommand(RAMCloud::RamCloud *, 
-    uint64_t,
-    std::vector<std::string> *argv);
+/* State of a command on an executor. A command either adds its reply to
+ * c->reply right away, or starts an asynchronous RAMCloud RPC, points rpc (or
+ * multiOp, for a multi-object RPC, or pushWait, for a group committed push) at
+ * it and sets cont. The executor then polls the RPC, and calls cont once it
+ * is ready. This lets an executor keep many commands waiting on RAMCloud at
+ * once. The reply buffer is shared by all commands on the executor, so a
+ * command adds its whole reply in the step that finishes it. */
+struct commandContext {
+  commandContext() :
+    client(NULL),
+    tableId(0),
+    segTableId(0),
+    argv(NULL),
+    reply(NULL),
+    rpc(NULL),
+    multiOp(NULL),
+    pushWait(NULL),
+    cont(NULL),
+    value(),
+    readRpc(),
+    writeRpc(),
+    multiRead(),
+    multiWrite(),
+    readObjects(),
+    readRequests(),
+    readValues(),
+    writeObjects(),
+    writeRequests(),
+    writeValues(),
+    multiNext(0),
+    heldReply(),
+    push(),
+    probes(),
+    rejectRules(),
+    req(),
+    startTime(0),
+    latency(NULL),
+    stats(NULL),
+    waitStart(0) {}
 
-std::string rpushCommand(RAMCloud::RamCloud *, 
-    uint64_t,
-    std::vector<std::string> *argv);
+  /* True if the command is waiting on an RPC. */
+  bool waiting() {
+    return rpc != NULL || multiOp != NULL || pushWait != NULL;
+  }
 
-std::string lpopCommand(RAMCloud::RamCloud *, 
-    uint64_t,
-    std::vector<std::string> *argv);
+  /* True once the RPC the command is waiting on has completed. */
+  bool rpcReady() {
+    if (rpc != NULL)
+      return rpc->isReady();
+    if (multiOp != NULL)
+      return multiOp->isReady();
+    return pushWait->state.load(std::memory_order_acquire) != PUSH_WAITING;
+  }
 
-std::string rpopCommand(RAMCloud::RamCloud *, 
-    uint64_t,
-    std::vector<std::string> *argv);
+  /* True while the command waits on a RAMCloud RPC. A push waiting on its
+   * group's leader isn't. */
+  bool rpcOutstanding() {
+    return rpc != NULL || multiOp != NULL;
+  }
 
-std::string lrangeCommand(RAMCloud::RamCloud *, 
-    uint64_t,
-    std::vector<std::string> *argv);
+  /* True if the next step commits a group of pushes, which it does in a
+   * blocking RAMCloud transaction. */
+  bool leadsPushGroup() {
+    return pushWait != NULL &&
+        pushWait->state.load(std::memory_order_acquire) == PUSH_LEAD;
+  }
+
+  /* Cancel whatever RPC is outstanding and drop its results. */
+  void cancelRpc() {
+    rpc = NULL;
+    multiOp = NULL;
+    pushWait = NULL;
+    cont = NULL;
+    readRpc.destroy();
+    writeRpc.destroy();
+    multiRead.destroy();
+    multiWrite.destroy();
+    for (size_t i = 0; i < readObjects.size(); i++)
+      readValues[i].destroy();
+    readObjects.clear();
+    readRequests.clear();
+    writeObjects.clear();
+    writeRequests.clear();
+    writeValues.clear();
+    probes.clear();
+    value.reset();
+  }
+
+  /* Cancel whatever RPC is outstanding and drop the request. */
+  void clear() {
+    cancelRpc();
+    multiNext = 0;
+    heldReply.clear();
+    push.error.clear();
+    push.state.store(PUSH_WAITING, std::memory_order_relaxed);
+    req = request();
+  }
+
+  RAMCloud::RamCloud *client;
+  uint64_t tableId;
+  uint64_t segTableId;       /* Table of list segments, see list.h. */
+  std::vector<argView> *argv;
+  replyBuffer *reply;        /* The executor's reply buffer. */
+  RAMCloud::RpcWrapper *rpc; /* RPC we are waiting on, or NULL. */
+  RAMCloud::MultiOp *multiOp; /* Multi-object RPC we are waiting on, or NULL. */
+  pushOp *pushWait;          /* Push we are waiting on, or NULL. */
+  commandCont *cont;         /* What to do once the RPC is ready. */
+  RAMCloud::Buffer value;    /* Value read by readRpc. */
+  RAMCloud::Tub<RAMCloud::ReadRpc> readRpc;
+  RAMCloud::Tub<RAMCloud::WriteRpc> writeRpc;
+  RAMCloud::Tub<RAMCloud::MultiRead> multiRead;
+  RAMCloud::Tub<RAMCloud::MultiWrite> multiWrite;
+  /* Objects of multiRead. Their values are read into readValues, which has
+   * room for REQUEST_BATCH_MAX of them and is allocated on first use. */
+  std::vector<RAMCloud::MultiReadObject> readObjects;
+  std::vector<RAMCloud::MultiReadObject*> readRequests;
+  std::unique_ptr<RAMCloud::Tub<RAMCloud::ObjectBuffer>[]> readValues;
+  /* Objects of multiWrite. */
+  std::vector<RAMCloud::MultiWriteObject> writeObjects;
+  std::vector<RAMCloud::MultiWriteObject*> writeRequests;
+  /* The values written by writeRpc or multiWrite, as they are stored. */
+  std::string writeValues;
+  /* Multi-key commands that need more than one multi-object RPC go through
+   * their keys in chunks. multiNext is the first key of the next chunk, and
+   * heldReply the reply to the chunks so far. */
+  size_t multiNext;
+  std::string heldReply;
+  pushOp push;               /* This command, if it is a push. */
+  /* Near cache lookups of the keys of a GET, one per request of a batch.
+   * Empty if the cache is disabled. */
+  std::vector<cacheProbe> probes;
+  /* Of a revalidating readRpc, or of the writeRpc of an INCR. */
+  RAMCloud::RejectRules rejectRules;
+  request req;               /* The request being executed. */
+  uint64_t startTime;        /* Cycles::rdtsc() when execution started. */
+  /* Where the executor records command times for admission control, or NULL
+   * if it is off. */
+  latencyWindow *latency;
+  commandTimes *stats;       /* The executor's per command statistics. */
+  /* Cycles::rdtsc() when the command started waiting, if the latency monitor
+   * is on. */
+  uint64_t waitStart;
+};
+
+void unsupportedCommand(commandContext *c);
+void getCommand(commandContext *c);
+void infoCommand(commandContext *c);
+void clientCommand(commandContext *c);
+void debugCommand(commandContext *c);
+void slowlogCommand(commandContext *c);
+void latencyCommand(commandContext *c);
+void incrCommand(commandContext *c);
+void setCommand(commandContext *c);
+void mgetCommand(commandContext *c);
+void msetCommand(commandContext *c);
+void lpushCommand(commandContext *c);
+void rpushCommand(commandContext *c);
+void lpopCommand(commandContext *c);
+void rpopCommand(commandContext *c);
+void lrangeCommand(commandContext *c);
+void llenCommand(commandContext *c);
+void lindexCommand(commandContext *c);
+void lsetCommand(commandContext *c);
 
 #endif
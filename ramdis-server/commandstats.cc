@@ -0,0 +1,80 @@
+#include <stdio.h>
+#include <vector>
+
+#include "commandstats.h"
+#include "Cycles.h"
+
+using RAMCloud::Cycles;
+
+static std::vector<commandTimes*> tables; /* One per executor. */
+
+void commandStatsInit(int numExecutors) {
+  for (int i = 0; i < numExecutors; i++)
+    tables.push_back(new commandTimes[commandCount()]);
+}
+
+commandTimes *commandStatsTable(int executor) {
+  return tables[executor];
+}
+
+/* Record calls of cmd that took cycles each. Only the executor owning the
+ * table may call this. */
+void commandStatsRecord(commandTimes *table, redisCommand *cmd,
+    uint64_t cycles, uint32_t calls) {
+  commandTimes &t = table[cmd - redisCommandTable];
+  t.times.record(Cycles::toMicroseconds(cycles), calls);
+  t.cycles.store(t.cycles.load(std::memory_order_relaxed) + cycles * calls,
+      std::memory_order_relaxed);
+}
+
+/* The calls of one command on all executors. */
+static uint64_t mergeCommand(int i, histogramSnapshot *snapshot) {
+  uint64_t cycles = 0;
+  for (auto table : tables) {
+    snapshot->add(table[i].times);
+    cycles += table[i].cycles.load(std::memory_order_relaxed);
+  }
+  return cycles;
+}
+
+/* Append the commandstats section of INFO, in the format of Redis. Commands
+ * that were never called are left out. */
+void commandStatsInfo(std::string *info) {
+  info->append("# Commandstats\r\n");
+  for (int i = 0; i < commandCount(); i++) {
+    histogramSnapshot snapshot;
+    uint64_t usec = Cycles::toMicroseconds(mergeCommand(i, &snapshot));
+    if (snapshot.count == 0)
+      continue;
+
+    char buf[256];
+    snprintf(buf, sizeof(buf),
+        "cmdstat_%s:calls=%llu,usec=%llu,usec_per_call=%.2f\r\n",
+        redisCommandTable[i].name, (unsigned long long)snapshot.count,
+        (unsigned long long)usec, (double)usec / snapshot.count);
+    info->append(buf);
+  }
+}
+
+/* Append the latencystats section of INFO. Percentiles are as fine as the
+ * histogram buckets, within an eighth of the value. */
+void latencyStatsInfo(std::string *info) {
+  info->append("# Latencystats\r\n");
+  for (int i = 0; i < commandCount(); i++) {
+    histogramSnapshot snapshot;
+    mergeCommand(i, &snapshot);
+    if (snapshot.count == 0)
+      continue;
+
+    char buf[256];
+    snprintf(buf, sizeof(buf),
+        "latency_percentiles_usec_%s:p50=%llu,p99=%llu,p99.9=%llu,"
+        "max=%llu\r\n",
+        redisCommandTable[i].name,
+        (unsigned long long)snapshot.percentile(50.0),
+        (unsigned long long)snapshot.percentile(99.0),
+        (unsigned long long)snapshot.percentile(99.9),
+        (unsigned long long)snapshot.max);
+    info->append(buf);
+  }
+}
@@ -0,0 +1,34 @@
+#ifndef __COMMANDSTATS_H
+#define __COMMANDSTATS_H
+
+#include <stdint.h>
+#include <string>
+
+#include "histogram.h"
+#include "ramdis-server.h"
+
+/* Per command statistics. Every executor has a table with an entry for each
+ * command in the command table, which only it writes to: a histogram of
+ * execution times in microseconds, and the total time in cycles. INFO adds
+ * the tables of all executors up when it is asked for them, so recording a
+ * command costs a few stores and no locks.
+ *
+ * A batch of requests counts as that many calls, each taking as long as the
+ * whole batch. Requests answered with an error before they execute, like an
+ * unknown command or one with the wrong number of arguments, are not
+ * counted. */
+
+struct commandTimes {
+  commandTimes() : times(), cycles(0) {}
+  histogram times;              /* Microseconds per call. */
+  std::atomic<uint64_t> cycles; /* Total of all calls. */
+};
+
+void commandStatsInit(int numExecutors);
+commandTimes *commandStatsTable(int executor);
+void commandStatsRecord(commandTimes *table, redisCommand *cmd,
+    uint64_t cycles, uint32_t calls);
+void commandStatsInfo(std::string *info);
+void latencyStatsInfo(std::string *info);
+
+#endif // __COMMANDSTATS_H
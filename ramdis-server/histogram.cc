@@ -0,0 +1,85 @@
+#include <string.h>
+
+#include "histogram.h"
+
+#define SUB_BUCKETS (1 << HISTOGRAM_SUB_BITS)
+
+static int bucketOf(uint64_t value) {
+  if (value < SUB_BUCKETS)
+    return (int)value;
+  if (value >= (1ULL << HISTOGRAM_MAX_BITS))
+    return HISTOGRAM_BUCKETS - 1;
+  int exp = 63 - __builtin_clzll(value);
+  int shift = exp - HISTOGRAM_SUB_BITS;
+  int sub = (int)(value >> shift) & (SUB_BUCKETS - 1);
+  return ((shift + 1) << HISTOGRAM_SUB_BITS) + sub;
+}
+
+/* The largest value that goes in bucket i. */
+static uint64_t bucketHigh(int i) {
+  if (i < SUB_BUCKETS)
+    return i;
+  int shift = (i >> HISTOGRAM_SUB_BITS) - 1;
+  uint64_t sub = i & (SUB_BUCKETS - 1);
+  return ((SUB_BUCKETS + sub + 1) << shift) - 1;
+}
+
+histogram::histogram() : count(0), sum(0), max(0) {
+  for (auto& c : counts)
+    c.store(0, std::memory_order_relaxed);
+}
+
+/* Record n values of value. */
+void histogram::record(uint64_t value, uint64_t n) {
+  std::atomic<uint64_t> &c = counts[bucketOf(value)];
+  c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+  count.store(count.load(std::memory_order_relaxed) + n,
+      std::memory_order_relaxed);
+  sum.store(sum.load(std::memory_order_relaxed) + value * n,
+      std::memory_order_relaxed);
+  if (value > max.load(std::memory_order_relaxed))
+    max.store(value, std::memory_order_relaxed);
+}
+
+/* Only the writer may clear a histogram. */
+void histogram::clear() {
+  for (auto& c : counts)
+    c.store(0, std::memory_order_relaxed);
+  count.store(0, std::memory_order_relaxed);
+  sum.store(0, std::memory_order_relaxed);
+  max.store(0, std::memory_order_relaxed);
+}
+
+histogramSnapshot::histogramSnapshot() : count(0), sum(0), max(0) {
+  memset(counts, 0, sizeof(counts));
+}
+
+void histogramSnapshot::add(const histogram &h) {
+  for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+    uint64_t n = h.counts[i].load(std::memory_order_relaxed);
+    counts[i] += n;
+    count += n;
+  }
+  sum += h.sum.load(std::memory_order_relaxed);
+  uint64_t m = h.max.load(std::memory_order_relaxed);
+  if (m > max)
+    max = m;
+}
+
+/* The value p percent of the values are at or below, rounded up to the end
+ * of its bucket, but no higher than the largest value seen. The last bucket
+ * has no end, so a value in it is taken to be the largest. */
+uint64_t histogramSnapshot::percentile(double p) const {
+  if (count == 0)
+    return 0;
+  uint64_t rank = (uint64_t)(p / 100.0 * count + 0.5);
+  if (rank < 1)
+    rank = 1;
+  uint64_t seen = 0;
+  for (int i = 0; i < HISTOGRAM_BUCKETS - 1; i++) {
+    seen += counts[i];
+    if (seen >= rank)
+      return bucketHigh(i) < max ? bucketHigh(i) : max;
+  }
+  return max;
+}
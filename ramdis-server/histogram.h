@@ -0,0 +1,44 @@
+#ifndef __HISTOGRAM_H
+#define __HISTOGRAM_H
+
+#include <stdint.h>
+#include <atomic>
+
+/* Log-linear histograms of latencies in microseconds, as in HdrHistogram.
+ * Values below 2^HISTOGRAM_SUB_BITS get a bucket each, and each power of two
+ * above that is split into 2^HISTOGRAM_SUB_BITS equal buckets, so a bucket is
+ * never wider than an eighth of the values in it. Values from
+ * 2^HISTOGRAM_MAX_BITS on (about 19 hours) all go in the last bucket.
+ *
+ * A histogram has a single writer, which doesn't need atomic read-modify-write
+ * instructions to update it. Other threads may read it at any time and get
+ * counts that are at most a few records behind. */
+
+#define HISTOGRAM_SUB_BITS 3
+#define HISTOGRAM_MAX_BITS 36
+#define HISTOGRAM_BUCKETS \
+  ((HISTOGRAM_MAX_BITS - HISTOGRAM_SUB_BITS + 1) << HISTOGRAM_SUB_BITS)
+
+struct histogram {
+  histogram();
+  void record(uint64_t value, uint64_t n = 1);
+  void clear();
+  std::atomic<uint64_t> counts[HISTOGRAM_BUCKETS];
+  std::atomic<uint64_t> count;
+  std::atomic<uint64_t> sum;
+  std::atomic<uint64_t> max;
+};
+
+/* A copy of one or more histograms added together, to compute percentiles
+ * from. */
+struct histogramSnapshot {
+  histogramSnapshot();
+  void add(const histogram &h);
+  uint64_t percentile(double p) const;
+  uint64_t counts[HISTOGRAM_BUCKETS];
+  uint64_t count;
+  uint64_t sum;
+  uint64_t max;
+};
+
+#endif // __HISTOGRAM_H
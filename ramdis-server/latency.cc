@@ -0,0 +1,144 @@
+#include <stdio.h>
+#include <string.h>
+#include <mutex>
+
+#include "latency.h"
+
+using RAMCloud::Cycles;
+
+static const char *eventNames[LATENCY_NUM_EVENTS] =
+    {"event-loop", "command", "rpc", "output-flush"};
+
+/* The spikes of one event. samples is a ring, idx its next slot. */
+struct latencyTimeSeries {
+  int idx;
+  latencySample samples[LATENCY_TS_LEN];
+  uint64_t max;       /* Largest spike ever, in milliseconds. */
+  uint64_t count;     /* Spikes ever, even those in the same second. */
+};
+
+uint64_t latencyThreshold = UINT64_MAX;
+static uint64_t thresholdMs;
+static std::mutex lock;
+static latencyTimeSeries series[LATENCY_NUM_EVENTS];
+
+/* A threshold of 0 turns the monitor off, as in Redis. */
+void latencyInit(uint64_t ms) {
+  thresholdMs = ms;
+  if (ms != 0)
+    latencyThreshold = Cycles::fromNanoseconds(ms * 1000000);
+}
+
+void latencyAddSample(int event, uint64_t cycles) {
+  uint64_t ms = Cycles::toMicroseconds(cycles) / 1000;
+  time_t now = time(NULL);
+
+  std::lock_guard<std::mutex> guard(lock);
+  latencyTimeSeries &ts = series[event];
+  ts.count++;
+  if (ms > ts.max)
+    ts.max = ms;
+
+  /* Keep the largest spike of each second. */
+  int prev = (ts.idx + LATENCY_TS_LEN - 1) % LATENCY_TS_LEN;
+  if (ts.samples[prev].time == now) {
+    if (ms > ts.samples[prev].latency)
+      ts.samples[prev].latency = ms;
+    return;
+  }
+  ts.samples[ts.idx].time = now;
+  ts.samples[ts.idx].latency = ms;
+  ts.idx = (ts.idx + 1) % LATENCY_TS_LEN;
+}
+
+const char *latencyEventName(int event) {
+  return eventNames[event];
+}
+
+/* The event of that name, or -1 if there is none. */
+int latencyEventByName(const std::string &name) {
+  for (int i = 0; i < LATENCY_NUM_EVENTS; i++) {
+    if (name == eventNames[i])
+      return i;
+  }
+  return -1;
+}
+
+/* The samples of an event, oldest first. The caller holds the lock. */
+static void eventSamples(int event, std::vector<latencySample> *samples) {
+  latencyTimeSeries &ts = series[event];
+  for (int i = 0; i < LATENCY_TS_LEN; i++) {
+    latencySample &s = ts.samples[(ts.idx + i) % LATENCY_TS_LEN];
+    if (s.time != 0)
+      samples->push_back(s);
+  }
+}
+
+/* The latest spike of an event and its largest ever, or false if it has had
+ * none. */
+bool latencyLatest(int event, latencySample *latest, uint64_t *max) {
+  std::lock_guard<std::mutex> guard(lock);
+  latencyTimeSeries &ts = series[event];
+  if (ts.count == 0)
+    return false;
+  *latest = ts.samples[(ts.idx + LATENCY_TS_LEN - 1) % LATENCY_TS_LEN];
+  *max = ts.max;
+  return true;
+}
+
+void latencyHistory(int event, std::vector<latencySample> *samples) {
+  std::lock_guard<std::mutex> guard(lock);
+  eventSamples(event, samples);
+}
+
+/* Forget the spikes of an event. Returns false if it had none. */
+bool latencyReset(int event) {
+  std::lock_guard<std::mutex> guard(lock);
+  if (series[event].count == 0)
+    return false;
+  memset(&series[event], 0, sizeof(series[event]));
+  return true;
+}
+
+/* A report on each event with spikes, and what might have caused them. */
+void latencyDoctor(std::string *report) {
+  static const char *advice[LATENCY_NUM_EVENTS] = {
+    "A reactor took long to get around its event loop. Check for clients "
+      "sending large pipelines, and whether the I/O threads get a core of "
+      "their own.",
+    "Commands took long to execute. SLOWLOG GET shows which ones.",
+    "RAMCloud took long to answer. Look for crash recovery, log cleaning or "
+      "migration on the masters at the times of the spikes.",
+    "Writing to a client took long. Check for clients that read their "
+      "replies slowly, and for large replies like LRANGE of a long list.",
+  };
+
+  std::lock_guard<std::mutex> guard(lock);
+  char buf[512];
+  snprintf(buf, sizeof(buf), "Latency monitor threshold: %llu ms.\n",
+      (unsigned long long)thresholdMs);
+  report->append(buf);
+
+  bool any = false;
+  for (int i = 0; i < LATENCY_NUM_EVENTS; i++) {
+    std::vector<latencySample> samples;
+    eventSamples(i, &samples);
+    if (samples.empty())
+      continue;
+    any = true;
+
+    uint64_t sum = 0;
+    for (auto const& s : samples)
+      sum += s.latency;
+    snprintf(buf, sizeof(buf),
+        "\n%s: %llu latency spikes (average %llu ms over the last %zu "
+        "seconds with spikes, worst %llu ms, latest %ld seconds ago).\n  %s\n",
+        eventNames[i], (unsigned long long)series[i].count,
+        (unsigned long long)(sum / samples.size()), samples.size(),
+        (unsigned long long)series[i].max,
+        (long)(time(NULL) - samples.back().time), advice[i]);
+    report->append(buf);
+  }
+  if (!any)
+    report->append("\nNo latency spikes so far.\n");
+}
@@ -0,0 +1,79 @@
+#ifndef __LATENCY_H
+#define __LATENCY_H
+
+#include <stdint.h>
+#include <time.h>
+#include <string>
+#include <vector>
+
+#include "Cycles.h"
+
+/* Latency monitor, after the one in Redis. Whenever something the server
+ * waits on takes at least --latency-monitor-threshold milliseconds, a sample
+ * of it goes in the time series of its event. A series holds the last
+ * LATENCY_TS_LEN seconds that had a spike, keeping the largest one of each
+ * second, so that spikes can be lined up with what RAMCloud was doing at the
+ * time, like a recovery or log cleaning.
+ *
+ * Below the threshold, recording costs a comparison. Spikes take a lock,
+ * since any reactor or executor may have one. */
+
+#define LATENCY_TS_LEN 160 /* Samples kept per event. */
+
+/* Events. */
+#define LATENCY_EVENT_LOOP 0   /* One iteration of a reactor's event loop. */
+#define LATENCY_COMMAND 1      /* Executing a command. */
+#define LATENCY_RPC 2          /* A command waiting on one RAMCloud RPC or
+                                * transaction. */
+#define LATENCY_FLUSH 3        /* Writing a client's output buffer. */
+#define LATENCY_NUM_EVENTS 4
+
+/* Duration in cycles from which on events are sampled, UINT64_MAX if the
+ * monitor is off. */
+extern uint64_t latencyThreshold;
+
+/* A spike, the largest of its second. */
+struct latencySample {
+  time_t time;        /* The second it falls in. */
+  uint64_t latency;   /* Milliseconds. */
+};
+
+void latencyInit(uint64_t thresholdMs);
+void latencyAddSample(int event, uint64_t cycles);
+const char *latencyEventName(int event);
+int latencyEventByName(const std::string &name);
+bool latencyLatest(int event, latencySample *latest, uint64_t *max);
+void latencyHistory(int event, std::vector<latencySample> *samples);
+bool latencyReset(int event);
+void latencyDoctor(std::string *report);
+
+static inline bool latencyMonitorEnabled() {
+  return latencyThreshold != UINT64_MAX;
+}
+
+/* Sample an event that took cycles, if that is long enough to count. */
+static inline void latencyAddSampleIfNeeded(int event, uint64_t cycles) {
+  if (cycles >= latencyThreshold)
+    latencyAddSample(event, cycles);
+}
+
+/* Samples the time from its construction to stop(), or to its destruction,
+ * as an "rpc" event. For commands that block the executor in synchronous
+ * RAMCloud calls, like the transactions of list commands, where there is no
+ * wait on an asynchronous RPC for the executor to time. */
+class latencyRpcTimer {
+ public:
+  latencyRpcTimer()
+    : start(latencyMonitorEnabled() ? RAMCloud::Cycles::rdtsc() : 0) {}
+  ~latencyRpcTimer() { stop(); }
+  void stop() {
+    if (start != 0)
+      latencyAddSampleIfNeeded(LATENCY_RPC,
+          RAMCloud::Cycles::rdtsc() - start);
+    start = 0;
+  }
+ private:
+  uint64_t start;
+};
+
+#endif // __LATENCY_H
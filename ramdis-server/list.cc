@@ -0,0 +1,293 @@
+#include <string.h>
+
+#include "list.h"
+#include "ClientException.h"
+
+uint64_t listIndex::length() const {
+  uint64_t len = 0;
+  for (auto const& entry : entries)
+    len += entry.elemCount;
+  return len;
+}
+
+/* Decode the value of a list's key. The entries are copied out of the
+ * buffer, since they are not aligned in it. */
+int listDecodeIndex(RAMCloud::Buffer *value, listIndex *index) {
+  uint32_t size = value->size();
+  if (size < sizeof(ObjectMetadata) ||
+      (size - sizeof(ObjectMetadata)) % sizeof(ListIndexEntry) != 0)
+    return LIST_WRONGTYPE;
+
+  value->copy(0, sizeof(ObjectMetadata), &index->meta);
+  if (index->meta.type != REDIS_LIST)
+    return LIST_WRONGTYPE;
+
+  index->entries.resize((size - sizeof(ObjectMetadata)) /
+      sizeof(ListIndexEntry));
+  value->copy(sizeof(ObjectMetadata), size - sizeof(ObjectMetadata),
+      index->entries.data());
+  return LIST_OK;
+}
+
+/* Read the index of the list at key. */
+int listReadIndex(RAMCloud::Transaction *tx, uint64_t tableId,
+    const argView &key, listIndex *index) {
+  RAMCloud::Buffer value;
+  try {
+    tx->read(tableId, key.data(), key.length(), &value);
+  } catch (RAMCloud::ObjectDoesntExistException& e) {
+    return LIST_NOT_FOUND;
+  }
+  return listDecodeIndex(&value, index);
+}
+
+/* Find element i, counted from the head, by walking the cumulative element
+ * counts of the segments. Returns the position of its segment in the index,
+ * and sets *pos to its position in the segment. i must be in the list. */
+size_t listLocate(const listIndex &index, uint64_t i, uint32_t *pos) {
+  size_t seg = 0;
+  while (i >= index.entries[seg].elemCount) {
+    i -= index.entries[seg].elemCount;
+    seg++;
+  }
+  *pos = i;
+  return seg;
+}
+
+/* Encode an index as the value of the list's key, the reverse of
+ * listDecodeIndex(). */
+void listEncodeIndex(const listIndex &index, std::string *value) {
+  value->reserve(sizeof(ObjectMetadata) +
+      index.entries.size() * sizeof(ListIndexEntry));
+  value->append((const char*)&index.meta, sizeof(ObjectMetadata));
+  value->append((const char*)index.entries.data(),
+      index.entries.size() * sizeof(ListIndexEntry));
+}
+
+/* Write the index of the list at key back, or remove the list if it has no
+ * segments left. */
+void listWriteIndex(RAMCloud::Transaction *tx, uint64_t tableId,
+    const argView &key, const listIndex &index) {
+  if (index.entries.empty()) {
+    tx->remove(tableId, key.data(), key.length());
+    return;
+  }
+
+  std::string value;
+  listEncodeIndex(index, &value);
+  tx->write(tableId, key.data(), key.length(), value.data(), value.size());
+}
+
+/* The key of a segment: the list's raw key followed by the segment id as a
+ * key component, length prefixed as appendKeyComponent() in libramdis does.
+ * Unlike libramdis, the list's key itself has no length prefix; see list.h. */
+std::string listSegmentKey(const argView &key, int16_t segId) {
+  uint16_t compLen = sizeof(int16_t);
+  std::string segKey(key.data(), key.length());
+  segKey.append((const char*)&compLen, sizeof(uint16_t));
+  segKey.append((const char*)&segId, sizeof(int16_t));
+  return segKey;
+}
+
+/* Read a segment the index lists from the segment table, segTableId. A
+ * missing segment means the list is corrupt, and the exception is passed
+ * on. */
+void listReadSegment(RAMCloud::Transaction *tx, uint64_t segTableId,
+    const argView &key, int16_t segId, RAMCloud::Buffer *value) {
+  std::string segKey = listSegmentKey(key, segId);
+  tx->read(segTableId, segKey.data(), segKey.size(), value);
+}
+
+/* Length of the i-th element of a segment. */
+uint16_t listSegmentElementLength(RAMCloud::Buffer *segment, uint32_t i) {
+  uint16_t len;
+  segment->copy(i * sizeof(uint16_t), sizeof(uint16_t), &len);
+  return len;
+}
+
+/* Offset of the data of the i-th element of a segment. */
+uint32_t listSegmentElementOffset(RAMCloud::Buffer *segment,
+    uint32_t elemCount, uint32_t i) {
+  uint32_t offset = elemCount * sizeof(uint16_t);
+  for (uint32_t j = 0; j < i; j++)
+    offset += listSegmentElementLength(segment, j);
+  return offset;
+}
+
+/* Encode the segment of elemCount elements in seg, with n values added to its
+ * head or tail end, into *newSegment. Values added to the head end up in
+ * reverse order, as LPUSH leaves them. */
+void listSegmentAdd(const char *seg, uint32_t size, uint32_t elemCount,
+    int where, const argView *values, size_t n, std::string *newSegment) {
+  uint32_t lensSize = elemCount * sizeof(uint16_t);
+  if (where == LIST_HEAD) {
+    for (size_t j = n; j-- > 0; ) {
+      uint16_t len = (uint16_t)values[j].length();
+      newSegment->append((const char*)&len, sizeof(uint16_t));
+    }
+    newSegment->append(seg, lensSize);
+    for (size_t j = n; j-- > 0; )
+      newSegment->append(values[j].data(), values[j].length());
+    newSegment->append(seg + lensSize, size - lensSize);
+  } else {
+    newSegment->append(seg, lensSize);
+    for (size_t j = 0; j < n; j++) {
+      uint16_t len = (uint16_t)values[j].length();
+      newSegment->append((const char*)&len, sizeof(uint16_t));
+    }
+    newSegment->append(seg + lensSize, size - lensSize);
+    for (size_t j = 0; j < n; j++)
+      newSegment->append(values[j].data(), values[j].length());
+  }
+}
+
+/* Take the head or tail element of the segment of elemCount elements in seg
+ * into *value, and encode what is left into *newSegment, which is empty if
+ * that was the last element. */
+void listSegmentRemove(const char *seg, uint32_t size, uint32_t elemCount,
+    int where, std::string *value, std::string *newSegment) {
+  uint32_t lensSize = elemCount * sizeof(uint16_t);
+  if (where == LIST_HEAD) {
+    uint16_t len;
+    memcpy(&len, seg, sizeof(uint16_t));
+    value->assign(seg + lensSize, len);
+    newSegment->append(seg + sizeof(uint16_t), lensSize - sizeof(uint16_t));
+    newSegment->append(seg + lensSize + len, size - lensSize - len);
+  } else {
+    uint16_t len;
+    memcpy(&len, seg + lensSize - sizeof(uint16_t), sizeof(uint16_t));
+    value->assign(seg + size - len, len);
+    newSegment->append(seg, lensSize - sizeof(uint16_t));
+    newSegment->append(seg + lensSize, size - lensSize - len);
+  }
+}
+
+/* Segment ids count up towards the head and down towards the tail, wrapping
+ * around at the ends of the int16_t range. */
+static int16_t nextSegmentId(int16_t segId, int where) {
+  uint16_t id = (uint16_t)segId;
+  return (int16_t)(where == LIST_HEAD ? id + 1 : id - 1);
+}
+
+/* Push count values onto the head or tail of a list, one after the other,
+ * as LPUSH and RPUSH do. They go into the segment at that end until it
+ * reaches MAX_LIST_SEG_SIZE_KB, and then into new segments, and every segment
+ * is written once. The caller writes the updated index. Returns C_ERR if the
+ * list has no room for another segment. */
+int listPush(RAMCloud::Transaction *tx, uint64_t segTableId,
+    const argView &key, listIndex *index, int where, const argView *values,
+    size_t count) {
+  std::vector<ListIndexEntry> &entries = index->entries;
+
+  size_t i = 0;
+  while (i < count) {
+    RAMCloud::Buffer segment;
+    if (entries.empty() ||
+        (where == LIST_HEAD ? entries.front() : entries.back()).segSizeKb >=
+          MAX_LIST_SEG_SIZE_KB) {
+      if (entries.size() >= MAX_LIST_SEGMENTS)
+        return C_ERR;
+
+      ListIndexEntry entry;
+      memset(&entry, 0, sizeof(entry));
+      if (!entries.empty()) {
+        entry.segId = nextSegmentId(where == LIST_HEAD ?
+            entries.front().segId : entries.back().segId, where);
+      }
+      if (where == LIST_HEAD)
+        entries.insert(entries.begin(), entry);
+      else
+        entries.push_back(entry);
+    } else {
+      ListIndexEntry &entry = where == LIST_HEAD ?
+          entries.front() : entries.back();
+      listReadSegment(tx, segTableId, key, entry.segId, &segment);
+    }
+
+    /* Take as many of the values as fit in this segment. */
+    size_t size = segment.size();
+    size_t n = 0;
+    while (i + n < count && (size >> 10) < MAX_LIST_SEG_SIZE_KB) {
+      size += sizeof(uint16_t) + values[i + n].length();
+      n++;
+    }
+
+    ListIndexEntry &entry = where == LIST_HEAD ?
+        entries.front() : entries.back();
+    std::string newSegment;
+    newSegment.reserve(size);
+    listSegmentAdd(static_cast<const char*>(
+          segment.getRange(0, segment.size())), segment.size(),
+        entry.elemCount, where, &values[i], n, &newSegment);
+
+    entry.elemCount += n;
+    entry.segSizeKb = (uint8_t)(newSegment.size() >> 10);
+
+    std::string segKey = listSegmentKey(key, entry.segId);
+    tx->write(segTableId, segKey.data(), segKey.size(), newSegment.data(),
+        newSegment.size());
+    i += n;
+  }
+  return C_OK;
+}
+
+/* Remove the head or tail element of a non-empty list into *value. A segment
+ * that is left empty is removed along with its index entry. The caller writes
+ * the updated index. */
+void listPop(RAMCloud::Transaction *tx, uint64_t segTableId,
+    const argView &key, listIndex *index, int where, std::string *value) {
+  std::vector<ListIndexEntry> &entries = index->entries;
+  ListIndexEntry &entry = where == LIST_HEAD ? entries.front() : entries.back();
+  std::string segKey = listSegmentKey(key, entry.segId);
+
+  RAMCloud::Buffer segment;
+  tx->read(segTableId, segKey.data(), segKey.size(), &segment);
+  std::string newSegment;
+  listSegmentRemove(static_cast<const char*>(
+        segment.getRange(0, segment.size())), segment.size(),
+      entry.elemCount, where, value, &newSegment);
+
+  if (entry.elemCount == 1) {
+    tx->remove(segTableId, segKey.data(), segKey.size());
+    if (where == LIST_HEAD)
+      entries.erase(entries.begin());
+    else
+      entries.pop_back();
+    return;
+  }
+
+  entry.elemCount--;
+  entry.segSizeKb = (uint8_t)(newSegment.size() >> 10);
+  tx->write(segTableId, segKey.data(), segKey.size(), newSegment.data(),
+      newSegment.size());
+}
+
+/* Replace element pos of segment seg of a list with value, rewriting only
+ * that segment. Returns true if the index changed and needs to be written
+ * too. */
+bool listSet(RAMCloud::Transaction *tx, uint64_t segTableId,
+    const argView &key, listIndex *index, size_t seg, uint32_t pos,
+    const argView &value) {
+  ListIndexEntry &entry = index->entries[seg];
+  std::string segKey = listSegmentKey(key, entry.segId);
+
+  RAMCloud::Buffer segment;
+  tx->read(segTableId, segKey.data(), segKey.size(), &segment);
+  const char *old = static_cast<const char*>(
+      segment.getRange(0, segment.size()));
+  uint16_t oldLen = listSegmentElementLength(&segment, pos);
+  uint32_t offset = listSegmentElementOffset(&segment, entry.elemCount, pos);
+  uint16_t len = (uint16_t)value.length();
+
+  std::string newSegment(old, segment.size());
+  memcpy(&newSegment[pos * sizeof(uint16_t)], &len, sizeof(uint16_t));
+  newSegment.replace(offset, oldLen, value.data(), len);
+  tx->write(segTableId, segKey.data(), segKey.size(), newSegment.data(),
+      newSegment.size());
+
+  uint8_t segSizeKb = (uint8_t)(newSegment.size() >> 10);
+  if (segSizeKb == entry.segSizeKb)
+    return false;
+  entry.segSizeKb = segSizeKb;
+  return true;
+}
@@ -0,0 +1,87 @@
+#ifndef __LIST_H
+#define __LIST_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "ramdis-server.h"
+#include "RamCloud.h"
+#include "Transaction.h"
+
+/* Lists are stored in the segmented layout of libramdis. The list's key holds
+ * an ObjectMetadata header followed by an index of ListIndexEntry, one per
+ * segment, head segment first. Segment segId is stored under the list's key
+ * with segId appended as a key component, and holds the uint16_t lengths of
+ * its elements followed by the elements themselves, head first.
+ *
+ * The RAMCloud keys are not those of libramdis, though. libramdis writes the
+ * list's key as a length prefixed key component too, while here it is the raw
+ * key, like the keys of strings, so that a list and a string of the same name
+ * are one key, and LPUSH on a string is a WRONGTYPE error as in Redis. Strings
+ * have an ObjectMetadata header of their own to tell them apart. Segments are
+ * kept in a table of their own, so no key a client can name reaches them.
+ * Lists written through libramdis can't be read here, or the other way
+ * around.
+ *
+ * Pushes add to the head or tail segment until it reaches
+ * MAX_LIST_SEG_SIZE_KB. After that LPUSH starts a new head segment with the
+ * next higher segId, and RPUSH a new tail segment with the next lower one.
+ * Segments that pops leave empty are removed, and so is the list once it has
+ * no elements left. Every update runs in a RAMCloud transaction and touches
+ * the index and one segment at each end it pushes to or pops from. */
+
+struct ListIndexEntry {
+  int16_t segId;
+  uint16_t elemCount;
+  uint8_t segSizeKb;
+};
+
+#define MAX_LIST_SEG_SIZE_KB 5
+/* Segment ids must not wrap around into each other. */
+#define MAX_LIST_SEGMENTS INT16_MAX
+
+/* List ends. */
+#define LIST_HEAD 0
+#define LIST_TAIL 1
+
+/* Results of listReadIndex(). */
+#define LIST_OK 0
+#define LIST_NOT_FOUND 1
+#define LIST_WRONGTYPE 2
+
+/* The decoded index of a list. */
+struct listIndex {
+  listIndex() : meta(), entries() {}
+  uint64_t length() const;
+  ObjectMetadata meta;
+  std::vector<ListIndexEntry> entries; /* Head segment first. */
+};
+
+int listDecodeIndex(RAMCloud::Buffer *value, listIndex *index);
+void listEncodeIndex(const listIndex &index, std::string *value);
+int listReadIndex(RAMCloud::Transaction *tx, uint64_t tableId,
+    const argView &key, listIndex *index);
+size_t listLocate(const listIndex &index, uint64_t i, uint32_t *pos);
+void listWriteIndex(RAMCloud::Transaction *tx, uint64_t tableId,
+    const argView &key, const listIndex &index);
+std::string listSegmentKey(const argView &key, int16_t segId);
+void listReadSegment(RAMCloud::Transaction *tx, uint64_t segTableId,
+    const argView &key, int16_t segId, RAMCloud::Buffer *value);
+uint16_t listSegmentElementLength(RAMCloud::Buffer *segment, uint32_t i);
+uint32_t listSegmentElementOffset(RAMCloud::Buffer *segment,
+    uint32_t elemCount, uint32_t i);
+void listSegmentAdd(const char *seg, uint32_t size, uint32_t elemCount,
+    int where, const argView *values, size_t n, std::string *newSegment);
+void listSegmentRemove(const char *seg, uint32_t size, uint32_t elemCount,
+    int where, std::string *value, std::string *newSegment);
+int listPush(RAMCloud::Transaction *tx, uint64_t segTableId,
+    const argView &key, listIndex *index, int where, const argView *values,
+    size_t count);
+void listPop(RAMCloud::Transaction *tx, uint64_t segTableId,
+    const argView &key, listIndex *index, int where, std::string *value);
+bool listSet(RAMCloud::Transaction *tx, uint64_t segTableId,
+    const argView &key, listIndex *index, size_t seg, uint32_t pos,
+    const argView &value);
+
+#endif // __LIST_H
@@ -0,0 +1,225 @@
+#ifndef __MPMCQUEUE_H
+#define __MPMCQUEUE_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <atomic>
+#include <new>
+#include <utility>
+
+#define CACHE_LINE_SIZE 64
+
+/* Number of times a consumer polls an empty queue before going to sleep on
+ * the futex. Long enough to ride out the gap between back-to-back requests
+ * under load, short enough that idle threads go to sleep right away. */
+#define QUEUE_SPIN_ITERATIONS 2048
+
+static inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#endif
+}
+
+/* Lets threads sleep until some condition (e.g. "a queue is non-empty")
+ * becomes true, without taking a lock on the fast path. A waiter calls
+ * prepareWait(), re-checks its condition, and then either cancelWait()s or
+ * wait()s with the key prepareWait() returned. Whoever makes the condition
+ * true calls notify(), which only makes a futex system call when someone is
+ * actually waiting. */
+class eventCount {
+ public:
+  eventCount() : epoch(0), waiters(0) {}
+
+  uint32_t prepareWait() {
+    waiters.fetch_add(1, std::memory_order_seq_cst);
+    return epoch.load(std::memory_order_seq_cst);
+  }
+
+  void cancelWait() {
+    waiters.fetch_sub(1, std::memory_order_seq_cst);
+  }
+
+  void wait(uint32_t key) {
+    /* Returns right away if a notify() bumped the epoch since prepareWait(),
+     * so wakeups that race with going to sleep are not lost. */
+    while (epoch.load(std::memory_order_acquire) == key) {
+      syscall(SYS_futex, (uint32_t*)&epoch, FUTEX_WAIT_PRIVATE, key, NULL,
+          NULL, 0);
+    }
+    waiters.fetch_sub(1, std::memory_order_seq_cst);
+  }
+
+  void notify() {
+    /* Pairs with the seq_cst increment in prepareWait(): either we see the
+     * waiter, or the waiter's re-check sees our update. */
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiters.load(std::memory_order_seq_cst) == 0)
+      return;
+    epoch.fetch_add(1, std::memory_order_seq_cst);
+    syscall(SYS_futex, (uint32_t*)&epoch, FUTEX_WAKE_PRIVATE, 1, NULL, NULL,
+        0);
+  }
+
+  void notifyAll() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiters.load(std::memory_order_seq_cst) == 0)
+      return;
+    epoch.fetch_add(1, std::memory_order_seq_cst);
+    syscall(SYS_futex, (uint32_t*)&epoch, FUTEX_WAKE_PRIVATE, INT_MAX, NULL,
+        NULL, 0);
+  }
+
+ private:
+  std::atomic<uint32_t> epoch;
+  std::atomic<uint32_t> waiters;
+};
+
+/* Bounded multi-producer multi-consumer queue, after Dmitry Vyukov's design.
+ * Every slot carries a sequence number telling producers and consumers whether
+ * the slot is free or full for the current lap around the ring, so enqueue and
+ * dequeue are each a single CAS on the tail or head index and never take a
+ * lock. Entries are moved in and out, never copied. The capacity is rounded
+ * up to a power of two. */
+template<typename T>
+class mpmcQueue {
+ public:
+  /* If notEmpty is given, enqueues signal it instead of the queue's own
+   * eventCount. This lets a consumer that serves several queues sleep on a
+   * single eventCount shared by all of them. */
+  explicit mpmcQueue(size_t capacity, eventCount *notEmpty = NULL) :
+    mask(0),
+    slots(NULL),
+    tail(0),
+    head(0),
+    ownNotEmpty(),
+    notEmpty(notEmpty ? notEmpty : &ownNotEmpty) {
+    size_t size = 2;
+    while (size < capacity)
+      size <<= 1;
+    mask = size - 1;
+
+    void *mem;
+    if (posix_memalign(&mem, CACHE_LINE_SIZE, sizeof(slot) * size) != 0)
+      throw std::bad_alloc();
+    slots = static_cast<slot*>(mem);
+    for (size_t i = 0; i < size; i++)
+      slots[i].seq.store(i, std::memory_order_relaxed);
+  }
+
+  ~mpmcQueue() {
+    T discard;
+    while (tryDequeue(&discard)) {}
+    free(slots);
+  }
+
+  mpmcQueue(const mpmcQueue&) = delete;
+  mpmcQueue& operator=(const mpmcQueue&) = delete;
+
+  /* Move value into the queue. Returns false, leaving value untouched, if the
+   * queue is full. Wakes up a sleeping consumer, if there is one. */
+  bool tryEnqueue(T &&value) {
+    size_t pos = tail.load(std::memory_order_relaxed);
+    slot *s;
+    while (true) {
+      s = &slots[pos & mask];
+      size_t seq = s->seq.load(std::memory_order_acquire);
+      intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+      if (diff == 0) {
+        if (tail.compare_exchange_weak(pos, pos + 1,
+              std::memory_order_relaxed))
+          break;
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = tail.load(std::memory_order_relaxed);
+      }
+    }
+
+    new(&s->storage) T(std::move(value));
+    s->seq.store(pos + 1, std::memory_order_release);
+    notEmpty->notify();
+    return true;
+  }
+
+  /* Move the oldest entry into *value. Returns false if the queue is empty. */
+  bool tryDequeue(T *value) {
+    size_t pos = head.load(std::memory_order_relaxed);
+    slot *s;
+    while (true) {
+      s = &slots[pos & mask];
+      size_t seq = s->seq.load(std::memory_order_acquire);
+      intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+      if (diff == 0) {
+        if (head.compare_exchange_weak(pos, pos + 1,
+              std::memory_order_relaxed))
+          break;
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = head.load(std::memory_order_relaxed);
+      }
+    }
+
+    T *entry = reinterpret_cast<T*>(&s->storage);
+    *value = std::move(*entry);
+    entry->~T();
+    s->seq.store(pos + mask + 1, std::memory_order_release);
+    return true;
+  }
+
+  /* Dequeue, blocking until an entry is available. Spins for a while first,
+   * then sleeps on a futex so that idle consumers don't burn a core. */
+  void waitDequeue(T *value) {
+    for (int i = 0; i < QUEUE_SPIN_ITERATIONS; i++) {
+      if (tryDequeue(value))
+        return;
+      cpuRelax();
+    }
+
+    while (true) {
+      uint32_t key = notEmpty->prepareWait();
+      if (tryDequeue(value)) {
+        notEmpty->cancelWait();
+        return;
+      }
+      notEmpty->wait(key);
+      if (tryDequeue(value))
+        return;
+    }
+  }
+
+  /* Approximate number of entries. Exact only when nobody else is using the
+   * queue. */
+  size_t sizeGuess() const {
+    size_t t = tail.load(std::memory_order_relaxed);
+    size_t h = head.load(std::memory_order_relaxed);
+    return t > h ? t - h : 0;
+  }
+
+  size_t capacity() const { return mask + 1; }
+
+ private:
+  struct slot {
+    std::atomic<size_t> seq;
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+  };
+
+  /* Producers and consumers hammer tail and head respectively, so keep them
+   * on separate cache lines. Padding rather than alignas, because C++11
+   * operator new doesn't honor extended alignment. */
+  size_t mask;
+  slot *slots;
+  char pad0[CACHE_LINE_SIZE];
+  std::atomic<size_t> tail;
+  char pad1[CACHE_LINE_SIZE];
+  std::atomic<size_t> head;
+  char pad2[CACHE_LINE_SIZE];
+  eventCount ownNotEmpty;
+  eventCount *notEmpty;   /* Signalled whenever an entry is enqueued. */
+};
+
+#endif // __MPMCQUEUE_H
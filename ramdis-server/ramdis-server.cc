@@ -1,25 +1,76 @@
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/uio.h>
 #include <netdb.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <stdarg.h>
+#include <strings.h>
 #include <arpa/inet.h>
+#include <sched.h>
 #include <thread>
-#include <queue>
+#include <chrono>
+#include <algorithm>
+#include <atomic>
 
 #include "ramdis-server.h"
 #include "commands.h"
+#include "cache.h"
+#include "admission.h"
+#include "commandstats.h"
+#include "slowlog.h"
+#include "latency.h"
+#include "zmalloc.h"
 #include "RamCloud.h"
 #include "Cycles.h"
 #include "docopt.h"
+#include "../PerfUtils/TimeTrace.h"
+
+// Queue of parsed requests from all reactors, shared by executor threads.
+mpmcQueue<request> *requestQ;
+
+// With --key-affinity, a queue per executor thread instead, see
+// requestQueueFor(). Empty otherwise.
+std::vector<mpmcQueue<request>*> executorQs;
+
+// With --fast-threads, a queue for commands flagged CMD_FAST and one for the
+// rest instead, see requestLane(). Executors that take slow requests sleep on
+// slowEvents, which fast requests signal as well.
+mpmcQueue<request> *fastQ;
+mpmcQueue<request> *slowQ;
+eventCount slowEvents;
+
+/* Requests are counted and timed by lane whether or not they have queues of
+ * their own. */
+#define LANE_FAST 0
+#define LANE_SLOW 1
+#define NUM_LANES 2
+
+struct laneStats {
+  laneStats() : requests(0), waitCycles(0), maxWaitCycles(0) {}
+  std::atomic<uint64_t> requests;
+  std::atomic<uint64_t> waitCycles;    /* Time spent in the request queue. */
+  std::atomic<uint64_t> maxWaitCycles;
+};
+
+laneStats lanes[NUM_LANES];
+
+// Max requests a client may have in the request queue or executing at once.
+// Zero means no limit.
+uint32_t clientMaxInflight;
 
-// Queue elements are (file descriptor, request arguements) 
-std::queue<std::pair<int, std::vector<std::string>>> requestQ;
-std::mutex requestQMutex;
-// Queue elements are (file descriptor, response string)
-std::queue<std::pair<int, std::string>> responseQ;
-std::mutex responseQMutex;
+// All the I/O threads.
+std::vector<reactor*> reactors;
+
+// Client output buffer limits in bytes. Zero means no limit.
+size_t outputBufferSoftLimit;
+size_t outputBufferHardLimit;
+
+// Every traceSample-th request timed by a reactor goes in the time trace.
+// Zero means none do.
+uint32_t traceSample;
 
 /* Our command table.
  *
@@ -41,7 +92,8 @@ std::mutex responseQMutex;
  * calls: total number of calls of this command.
  *
  * The flags, microseconds and calls fields are computed by Redis and should
- * always be set to zero.
+ * always be set to zero. ramdis-server keeps call counts and times per
+ * executor instead (see commandstats.h), and leaves the last two at zero.
  *
  * Command flags are expressed using strings where every character represents
  * a flag. Later the populateCommandTable() function will take care of
@@ -71,355 +123,286 @@ std::mutex responseQMutex;
  * F: Fast command: O(1) or O(log(N)) command that should never delay
  *    its execution as long as the kernel scheduler is giving us time.
  *    Note that commands that may trigger a DEL as a side effect (like SET)
- *    are not fast commands.
+ *    are not fast commands. Here F also puts a command in the fast lane
+ *    (see requestLane()), so commands that run a RAMCloud transaction, which
+ *    blocks the executor until it commits, are not flagged F either. That
+ *    goes for the list writes, even where Redis has them as fast.
+ * T: the command runs a RAMCloud transaction, which blocks its executor until
+ *    it commits, so it waits for the executor's other RPCs to complete
+ *    first (see requestExecutor()). Pushes aren't flagged: their group
+ *    commit is held back the same way when it is the push's turn to lead.
  */
-std::map<std::string, redisCommand> redisCommandTable = {
-    {"get", {"get",getCommand,2,"rF",0,NULL,1,1,1,0,0}},
-    {"GET", {"get",getCommand,2,"rF",0,NULL,1,1,1,0,0}},
-    {"set", {"set",setCommand,-3,"wm",0,NULL,1,1,1,0,0}},
-    {"SET", {"set",setCommand,-3,"wm",0,NULL,1,1,1,0,0}},
-    {"setnx", {"setnx",unsupportedCommand,3,"wmF",0,NULL,1,1,1,0,0}},
-    {"SETNX", {"setnx",unsupportedCommand,3,"wmF",0,NULL,1,1,1,0,0}},
-    {"setex", {"setex",unsupportedCommand,4,"wm",0,NULL,1,1,1,0,0}},
-    {"SETEX", {"setex",unsupportedCommand,4,"wm",0,NULL,1,1,1,0,0}},
-    {"psetex", {"psetex",unsupportedCommand,4,"wm",0,NULL,1,1,1,0,0}},
-    {"PSETEX", {"psetex",unsupportedCommand,4,"wm",0,NULL,1,1,1,0,0}},
-    {"append", {"append",unsupportedCommand,3,"wm",0,NULL,1,1,1,0,0}},
-    {"APPEND", {"append",unsupportedCommand,3,"wm",0,NULL,1,1,1,0,0}},
-    {"strlen", {"strlen",unsupportedCommand,2,"rF",0,NULL,1,1,1,0,0}},
-    {"STRLEN", {"strlen",unsupportedCommand,2,"rF",0,NULL,1,1,1,0,0}},
-    {"del", {"del",unsupportedCommand,-2,"w",0,NULL,1,-1,1,0,0}},
-    {"DEL", {"del",unsupportedCommand,-2,"w",0,NULL,1,-1,1,0,0}},
-    {"exists", {"exists",unsupportedCommand,-2,"rF",0,NULL,1,-1,1,0,0}},
-    {"EXISTS", {"exists",unsupportedCommand,-2,"rF",0,NULL,1,-1,1,0,0}},
-    {"setbit", {"setbit",unsupportedCommand,4,"wm",0,NULL,1,1,1,0,0}},
-    {"SETBIT", {"setbit",unsupportedCommand,4,"wm",0,NULL,1,1,1,0,0}},
-    {"getbit", {"getbit",unsupportedCommand,3,"rF",0,NULL,1,1,1,0,0}},
-    {"GETBIT", {"getbit",unsupportedCommand,3,"rF",0,NULL,1,1,1,0,0}},
-    {"bitfield", {"bitfield",unsupportedCommand,-2,"wm",0,NULL,1,1,1,0,0}},
-    {"BITFIELD", {"bitfield",unsupportedCommand,-2,"wm",0,NULL,1,1,1,0,0}},
-    {"setrange", {"setrange",unsupportedCommand,4,"wm",0,NULL,1,1,1,0,0}},
-    {"SETRANGE", {"setrange",unsupportedCommand,4,"wm",0,NULL,1,1,1,0,0}},
-    {"getrange", {"getrange",unsupportedCommand,4,"r",0,NULL,1,1,1,0,0}},
-    {"GETRANGE", {"getrange",unsupportedCommand,4,"r",0,NULL,1,1,1,0,0}},
-    {"substr", {"substr",unsupportedCommand,4,"r",0,NULL,1,1,1,0,0}},
-    {"SUBSTR", {"substr",unsupportedCommand,4,"r",0,NULL,1,1,1,0,0}},
-    {"incr", {"incr",incrCommand,2,"wmF",0,NULL,1,1,1,0,0}},
-    {"INCR", {"incr",incrCommand,2,"wmF",0,NULL,1,1,1,0,0}},
-    {"decr", {"decr",unsupportedCommand,2,"wmF",0,NULL,1,1,1,0,0}},
-    {"DECR", {"decr",unsupportedCommand,2,"wmF",0,NULL,1,1,1,0,0}},
-    {"mget", {"mget",unsupportedCommand,-2,"r",0,NULL,1,-1,1,0,0}},
-    {"MGET", {"mget",unsupportedCommand,-2,"r",0,NULL,1,-1,1,0,0}},
-    {"rpush", {"rpush",rpushCommand,-3,"wmF",0,NULL,1,1,1,0,0}},
-    {"RPUSH", {"rpush",rpushCommand,-3,"wmF",0,NULL,1,1,1,0,0}},
-    {"lpush", {"lpush",lpushCommand,-3,"wmF",0,NULL,1,1,1,0,0}},
-    {"LPUSH", {"lpush",lpushCommand,-3,"wmF",0,NULL,1,1,1,0,0}},
-    {"rpushx", {"rpushx",unsupportedCommand,3,"wmF",0,NULL,1,1,1,0,0}},
-    {"RPUSHX", {"rpushx",unsupportedCommand,3,"wmF",0,NULL,1,1,1,0,0}},
-    {"lpushx", {"lpushx",unsupportedCommand,3,"wmF",0,NULL,1,1,1,0,0}},
-    {"LPUSHX", {"lpushx",unsupportedCommand,3,"wmF",0,NULL,1,1,1,0,0}},
-    {"linsert", {"linsert",unsupportedCommand,5,"wm",0,NULL,1,1,1,0,0}},
-    {"LINSERT", {"linsert",unsupportedCommand,5,"wm",0,NULL,1,1,1,0,0}},
-    {"rpop", {"rpop",rpopCommand,2,"wF",0,NULL,1,1,1,0,0}},
-    {"RPOP", {"rpop",rpopCommand,2,"wF",0,NULL,1,1,1,0,0}},
-    {"lpop", {"lpop",lpopCommand,2,"wF",0,NULL,1,1,1,0,0}},
-    {"LPOP", {"lpop",lpopCommand,2,"wF",0,NULL,1,1,1,0,0}},
-    {"brpop", {"brpop",unsupportedCommand,-3,"ws",0,NULL,1,1,1,0,0}},
-    {"BRPOP", {"brpop",unsupportedCommand,-3,"ws",0,NULL,1,1,1,0,0}},
-    {"brpoplpush", {"brpoplpush",unsupportedCommand,4,"wms",0,NULL,1,2,1,0,0}},
-    {"BRPOPLPUSH", {"brpoplpush",unsupportedCommand,4,"wms",0,NULL,1,2,1,0,0}},
-    {"blpop", {"blpop",unsupportedCommand,-3,"ws",0,NULL,1,-2,1,0,0}},
-    {"BLPOP", {"blpop",unsupportedCommand,-3,"ws",0,NULL,1,-2,1,0,0}},
-    {"llen", {"llen",unsupportedCommand,2,"rF",0,NULL,1,1,1,0,0}},
-    {"LLEN", {"llen",unsupportedCommand,2,"rF",0,NULL,1,1,1,0,0}},
-    {"lindex", {"lindex",unsupportedCommand,3,"r",0,NULL,1,1,1,0,0}},
-    {"LINDEX", {"lindex",unsupportedCommand,3,"r",0,NULL,1,1,1,0,0}},
-    {"lset", {"lset",unsupportedCommand,4,"wm",0,NULL,1,1,1,0,0}},
-    {"LSET", {"lset",unsupportedCommand,4,"wm",0,NULL,1,1,1,0,0}},
-    {"lrange", {"lrange",lrangeCommand,4,"r",0,NULL,1,1,1,0,0}},
-    {"LRANGE", {"lrange",lrangeCommand,4,"r",0,NULL,1,1,1,0,0}},
-    {"ltrim", {"ltrim",unsupportedCommand,4,"w",0,NULL,1,1,1,0,0}},
-    {"LTRIM", {"ltrim",unsupportedCommand,4,"w",0,NULL,1,1,1,0,0}},
-    {"lrem", {"lrem",unsupportedCommand,4,"w",0,NULL,1,1,1,0,0}},
-    {"LREM", {"lrem",unsupportedCommand,4,"w",0,NULL,1,1,1,0,0}},
-    {"rpoplpush", {"rpoplpush",unsupportedCommand,3,"wm",0,NULL,1,2,1,0,0}},
-    {"RPOPLPUSH", {"rpoplpush",unsupportedCommand,3,"wm",0,NULL,1,2,1,0,0}},
-    {"sadd", {"sadd",unsupportedCommand,-3,"wmF",0,NULL,1,1,1,0,0}},
-    {"SADD", {"sadd",unsupportedCommand,-3,"wmF",0,NULL,1,1,1,0,0}},
-    {"srem", {"srem",unsupportedCommand,-3,"wF",0,NULL,1,1,1,0,0}},
-    {"SREM", {"srem",unsupportedCommand,-3,"wF",0,NULL,1,1,1,0,0}},
-    {"smove", {"smove",unsupportedCommand,4,"wF",0,NULL,1,2,1,0,0}},
-    {"SMOVE", {"smove",unsupportedCommand,4,"wF",0,NULL,1,2,1,0,0}},
-    {"sismember", {"sismember",unsupportedCommand,3,"rF",0,NULL,1,1,1,0,0}},
-    {"SISMEMBER", {"sismember",unsupportedCommand,3,"rF",0,NULL,1,1,1,0,0}},
-    {"scard", {"scard",unsupportedCommand,2,"rF",0,NULL,1,1,1,0,0}},
-    {"SCARD", {"scard",unsupportedCommand,2,"rF",0,NULL,1,1,1,0,0}},
-    {"spop", {"spop",unsupportedCommand,-2,"wRF",0,NULL,1,1,1,0,0}},
-    {"SPOP", {"spop",unsupportedCommand,-2,"wRF",0,NULL,1,1,1,0,0}},
-    {"srandmember", {"srandmember",unsupportedCommand,-2,"rR",0,NULL,1,1,1,0,0}},
-    {"SRANDMEMBER", {"srandmember",unsupportedCommand,-2,"rR",0,NULL,1,1,1,0,0}},
-    {"sinter", {"sinter",unsupportedCommand,-2,"rS",0,NULL,1,-1,1,0,0}},
-    {"SINTER", {"sinter",unsupportedCommand,-2,"rS",0,NULL,1,-1,1,0,0}},
-    {"sinterstore", {"sinterstore",unsupportedCommand,-3,"wm",0,NULL,1,-1,1,0,0}},
-    {"SINTERSTORE", {"sinterstore",unsupportedCommand,-3,"wm",0,NULL,1,-1,1,0,0}},
-    {"sunion", {"sunion",unsupportedCommand,-2,"rS",0,NULL,1,-1,1,0,0}},
-    {"SUNION", {"sunion",unsupportedCommand,-2,"rS",0,NULL,1,-1,1,0,0}},
-    {"sunionstore", {"sunionstore",unsupportedCommand,-3,"wm",0,NULL,1,-1,1,0,0}},
-    {"SUNIONSTORE", {"sunionstore",unsupportedCommand,-3,"wm",0,NULL,1,-1,1,0,0}},
-    {"sdiff", {"sdiff",unsupportedCommand,-2,"rS",0,NULL,1,-1,1,0,0}},
-    {"SDIFF", {"sdiff",unsupportedCommand,-2,"rS",0,NULL,1,-1,1,0,0}},
-    {"sdiffstore", {"sdiffstore",unsupportedCommand,-3,"wm",0,NULL,1,-1,1,0,0}},
-    {"SDIFFSTORE", {"sdiffstore",unsupportedCommand,-3,"wm",0,NULL,1,-1,1,0,0}},
-    {"smembers", {"smembers",unsupportedCommand,2,"rS",0,NULL,1,1,1,0,0}},
-    {"SMEMBERS", {"smembers",unsupportedCommand,2,"rS",0,NULL,1,1,1,0,0}},
-    {"sscan", {"sscan",unsupportedCommand,-3,"rR",0,NULL,1,1,1,0,0}},
-    {"SSCAN", {"sscan",unsupportedCommand,-3,"rR",0,NULL,1,1,1,0,0}},
-    {"zadd", {"zadd",unsupportedCommand,-4,"wmF",0,NULL,1,1,1,0,0}},
-    {"ZADD", {"zadd",unsupportedCommand,-4,"wmF",0,NULL,1,1,1,0,0}},
-    {"zincrby", {"zincrby",unsupportedCommand,4,"wmF",0,NULL,1,1,1,0,0}},
-    {"ZINCRBY", {"zincrby",unsupportedCommand,4,"wmF",0,NULL,1,1,1,0,0}},
-    {"zrem", {"zrem",unsupportedCommand,-3,"wF",0,NULL,1,1,1,0,0}},
-    {"ZREM", {"zrem",unsupportedCommand,-3,"wF",0,NULL,1,1,1,0,0}},
-    {"zremrangebyscore", {"zremrangebyscore",unsupportedCommand,4,"w",0,NULL,1,1,1,0,0}},
-    {"ZREMRANGEBYSCORE", {"zremrangebyscore",unsupportedCommand,4,"w",0,NULL,1,1,1,0,0}},
-    {"zremrangebyrank", {"zremrangebyrank",unsupportedCommand,4,"w",0,NULL,1,1,1,0,0}},
-    {"ZREMRANGEBYRANK", {"zremrangebyrank",unsupportedCommand,4,"w",0,NULL,1,1,1,0,0}},
-    {"zremrangebylex", {"zremrangebylex",unsupportedCommand,4,"w",0,NULL,1,1,1,0,0}},
-    {"ZREMRANGEBYLEX", {"zremrangebylex",unsupportedCommand,4,"w",0,NULL,1,1,1,0,0}},
-    {"zunionstore", {"zunionstore",unsupportedCommand,-4,"wm",0,NULL,0,0,0,0,0}},
-    {"ZUNIONSTORE", {"zunionstore",unsupportedCommand,-4,"wm",0,NULL,0,0,0,0,0}},
-    {"zinterstore", {"zinterstore",unsupportedCommand,-4,"wm",0,NULL,0,0,0,0,0}},
-    {"ZINTERSTORE", {"zinterstore",unsupportedCommand,-4,"wm",0,NULL,0,0,0,0,0}},
-    {"zrange", {"zrange",unsupportedCommand,-4,"r",0,NULL,1,1,1,0,0}},
-    {"ZRANGE", {"zrange",unsupportedCommand,-4,"r",0,NULL,1,1,1,0,0}},
-    {"zrangebyscore", {"zrangebyscore",unsupportedCommand,-4,"r",0,NULL,1,1,1,0,0}},
-    {"ZRANGEBYSCORE", {"zrangebyscore",unsupportedCommand,-4,"r",0,NULL,1,1,1,0,0}},
-    {"zrevrangebyscore", {"zrevrangebyscore",unsupportedCommand,-4,"r",0,NULL,1,1,1,0,0}},
-    {"ZREVRANGEBYSCORE", {"zrevrangebyscore",unsupportedCommand,-4,"r",0,NULL,1,1,1,0,0}},
-    {"zrangebylex", {"zrangebylex",unsupportedCommand,-4,"r",0,NULL,1,1,1,0,0}},
-    {"ZRANGEBYLEX", {"zrangebylex",unsupportedCommand,-4,"r",0,NULL,1,1,1,0,0}},
-    {"zrevrangebylex", {"zrevrangebylex",unsupportedCommand,-4,"r",0,NULL,1,1,1,0,0}},
-    {"ZREVRANGEBYLEX", {"zrevrangebylex",unsupportedCommand,-4,"r",0,NULL,1,1,1,0,0}},
-    {"zcount", {"zcount",unsupportedCommand,4,"rF",0,NULL,1,1,1,0,0}},
-    {"ZCOUNT", {"zcount",unsupportedCommand,4,"rF",0,NULL,1,1,1,0,0}},
-    {"zlexcount", {"zlexcount",unsupportedCommand,4,"rF",0,NULL,1,1,1,0,0}},
-    {"ZLEXCOUNT", {"zlexcount",unsupportedCommand,4,"rF",0,NULL,1,1,1,0,0}},
-    {"zrevrange", {"zrevrange",unsupportedCommand,-4,"r",0,NULL,1,1,1,0,0}},
-    {"ZREVRANGE", {"zrevrange",unsupportedCommand,-4,"r",0,NULL,1,1,1,0,0}},
-    {"zcard", {"zcard",unsupportedCommand,2,"rF",0,NULL,1,1,1,0,0}},
-    {"ZCARD", {"zcard",unsupportedCommand,2,"rF",0,NULL,1,1,1,0,0}},
-    {"zscore", {"zscore",unsupportedCommand,3,"rF",0,NULL,1,1,1,0,0}},
-    {"ZSCORE", {"zscore",unsupportedCommand,3,"rF",0,NULL,1,1,1,0,0}},
-    {"zrank", {"zrank",unsupportedCommand,3,"rF",0,NULL,1,1,1,0,0}},
-    {"ZRANK", {"zrank",unsupportedCommand,3,"rF",0,NULL,1,1,1,0,0}},
-    {"zrevrank", {"zrevrank",unsupportedCommand,3,"rF",0,NULL,1,1,1,0,0}},
-    {"ZREVRANK", {"zrevrank",unsupportedCommand,3,"rF",0,NULL,1,1,1,0,0}},
-    {"zscan", {"zscan",unsupportedCommand,-3,"rR",0,NULL,1,1,1,0,0}},
-    {"ZSCAN", {"zscan",unsupportedCommand,-3,"rR",0,NULL,1,1,1,0,0}},
-    {"hset", {"hset",unsupportedCommand,4,"wmF",0,NULL,1,1,1,0,0}},
-    {"HSET", {"hset",unsupportedCommand,4,"wmF",0,NULL,1,1,1,0,0}},
-    {"hsetnx", {"hsetnx",unsupportedCommand,4,"wmF",0,NULL,1,1,1,0,0}},
-    {"HSETNX", {"hsetnx",unsupportedCommand,4,"wmF",0,NULL,1,1,1,0,0}},
-    {"hget", {"hget",unsupportedCommand,3,"rF",0,NULL,1,1,1,0,0}},
-    {"HGET", {"hget",unsupportedCommand,3,"rF",0,NULL,1,1,1,0,0}},
-    {"hmset", {"hmset",unsupportedCommand,-4,"wm",0,NULL,1,1,1,0,0}},
-    {"HMSET", {"hmset",unsupportedCommand,-4,"wm",0,NULL,1,1,1,0,0}},
-    {"hmget", {"hmget",unsupportedCommand,-3,"r",0,NULL,1,1,1,0,0}},
-    {"HMGET", {"hmget",unsupportedCommand,-3,"r",0,NULL,1,1,1,0,0}},
-    {"hincrby", {"hincrby",unsupportedCommand,4,"wmF",0,NULL,1,1,1,0,0}},
-    {"HINCRBY", {"hincrby",unsupportedCommand,4,"wmF",0,NULL,1,1,1,0,0}},
-    {"hincrbyfloat", {"hincrbyfloat",unsupportedCommand,4,"wmF",0,NULL,1,1,1,0,0}},
-    {"HINCRBYFLOAT", {"hincrbyfloat",unsupportedCommand,4,"wmF",0,NULL,1,1,1,0,0}},
-    {"hdel", {"hdel",unsupportedCommand,-3,"wF",0,NULL,1,1,1,0,0}},
-    {"HDEL", {"hdel",unsupportedCommand,-3,"wF",0,NULL,1,1,1,0,0}},
-    {"hlen", {"hlen",unsupportedCommand,2,"rF",0,NULL,1,1,1,0,0}},
-    {"HLEN", {"hlen",unsupportedCommand,2,"rF",0,NULL,1,1,1,0,0}},
-    {"hstrlen", {"hstrlen",unsupportedCommand,3,"rF",0,NULL,1,1,1,0,0}},
-    {"HSTRLEN", {"hstrlen",unsupportedCommand,3,"rF",0,NULL,1,1,1,0,0}},
-    {"hkeys", {"hkeys",unsupportedCommand,2,"rS",0,NULL,1,1,1,0,0}},
-    {"HKEYS", {"hkeys",unsupportedCommand,2,"rS",0,NULL,1,1,1,0,0}},
-    {"hvals", {"hvals",unsupportedCommand,2,"rS",0,NULL,1,1,1,0,0}},
-    {"HVALS", {"hvals",unsupportedCommand,2,"rS",0,NULL,1,1,1,0,0}},
-    {"hgetall", {"hgetall",unsupportedCommand,2,"r",0,NULL,1,1,1,0,0}},
-    {"HGETALL", {"hgetall",unsupportedCommand,2,"r",0,NULL,1,1,1,0,0}},
-    {"hexists", {"hexists",unsupportedCommand,3,"rF",0,NULL,1,1,1,0,0}},
-    {"HEXISTS", {"hexists",unsupportedCommand,3,"rF",0,NULL,1,1,1,0,0}},
-    {"hscan", {"hscan",unsupportedCommand,-3,"rR",0,NULL,1,1,1,0,0}},
-    {"HSCAN", {"hscan",unsupportedCommand,-3,"rR",0,NULL,1,1,1,0,0}},
-    {"incrby", {"incrby",unsupportedCommand,3,"wmF",0,NULL,1,1,1,0,0}},
-    {"INCRBY", {"incrby",unsupportedCommand,3,"wmF",0,NULL,1,1,1,0,0}},
-    {"decrby", {"decrby",unsupportedCommand,3,"wmF",0,NULL,1,1,1,0,0}},
-    {"DECRBY", {"decrby",unsupportedCommand,3,"wmF",0,NULL,1,1,1,0,0}},
-    {"incrbyfloat", {"incrbyfloat",unsupportedCommand,3,"wmF",0,NULL,1,1,1,0,0}},
-    {"INCRBYFLOAT", {"incrbyfloat",unsupportedCommand,3,"wmF",0,NULL,1,1,1,0,0}},
-    {"getset", {"getset",unsupportedCommand,3,"wm",0,NULL,1,1,1,0,0}},
-    {"GETSET", {"getset",unsupportedCommand,3,"wm",0,NULL,1,1,1,0,0}},
-    {"mset", {"mset",unsupportedCommand,-3,"wm",0,NULL,1,-1,2,0,0}},
-    {"MSET", {"mset",unsupportedCommand,-3,"wm",0,NULL,1,-1,2,0,0}},
-    {"msetnx", {"msetnx",unsupportedCommand,-3,"wm",0,NULL,1,-1,2,0,0}},
-    {"MSETNX", {"msetnx",unsupportedCommand,-3,"wm",0,NULL,1,-1,2,0,0}},
-    {"randomkey", {"randomkey",unsupportedCommand,1,"rR",0,NULL,0,0,0,0,0}},
-    {"RANDOMKEY", {"randomkey",unsupportedCommand,1,"rR",0,NULL,0,0,0,0,0}},
-    {"select", {"select",unsupportedCommand,2,"lF",0,NULL,0,0,0,0,0}},
-    {"SELECT", {"select",unsupportedCommand,2,"lF",0,NULL,0,0,0,0,0}},
-    {"move", {"move",unsupportedCommand,3,"wF",0,NULL,1,1,1,0,0}},
-    {"MOVE", {"move",unsupportedCommand,3,"wF",0,NULL,1,1,1,0,0}},
-    {"rename", {"rename",unsupportedCommand,3,"w",0,NULL,1,2,1,0,0}},
-    {"RENAME", {"rename",unsupportedCommand,3,"w",0,NULL,1,2,1,0,0}},
-    {"renamenx", {"renamenx",unsupportedCommand,3,"wF",0,NULL,1,2,1,0,0}},
-    {"RENAMENX", {"renamenx",unsupportedCommand,3,"wF",0,NULL,1,2,1,0,0}},
-    {"expire", {"expire",unsupportedCommand,3,"wF",0,NULL,1,1,1,0,0}},
-    {"EXPIRE", {"expire",unsupportedCommand,3,"wF",0,NULL,1,1,1,0,0}},
-    {"expireat", {"expireat",unsupportedCommand,3,"wF",0,NULL,1,1,1,0,0}},
-    {"EXPIREAT", {"expireat",unsupportedCommand,3,"wF",0,NULL,1,1,1,0,0}},
-    {"pexpire", {"pexpire",unsupportedCommand,3,"wF",0,NULL,1,1,1,0,0}},
-    {"PEXPIRE", {"pexpire",unsupportedCommand,3,"wF",0,NULL,1,1,1,0,0}},
-    {"pexpireat", {"pexpireat",unsupportedCommand,3,"wF",0,NULL,1,1,1,0,0}},
-    {"PEXPIREAT", {"pexpireat",unsupportedCommand,3,"wF",0,NULL,1,1,1,0,0}},
-    {"keys", {"keys",unsupportedCommand,2,"rS",0,NULL,0,0,0,0,0}},
-    {"KEYS", {"keys",unsupportedCommand,2,"rS",0,NULL,0,0,0,0,0}},
-    {"scan", {"scan",unsupportedCommand,-2,"rR",0,NULL,0,0,0,0,0}},
-    {"SCAN", {"scan",unsupportedCommand,-2,"rR",0,NULL,0,0,0,0,0}},
-    {"dbsize", {"dbsize",unsupportedCommand,1,"rF",0,NULL,0,0,0,0,0}},
-    {"DBSIZE", {"dbsize",unsupportedCommand,1,"rF",0,NULL,0,0,0,0,0}},
-    {"auth", {"auth",unsupportedCommand,2,"sltF",0,NULL,0,0,0,0,0}},
-    {"AUTH", {"auth",unsupportedCommand,2,"sltF",0,NULL,0,0,0,0,0}},
-    {"ping", {"ping",unsupportedCommand,-1,"tF",0,NULL,0,0,0,0,0}},
-    {"PING", {"ping",unsupportedCommand,-1,"tF",0,NULL,0,0,0,0,0}},
-    {"echo", {"echo",unsupportedCommand,2,"F",0,NULL,0,0,0,0,0}},
-    {"ECHO", {"echo",unsupportedCommand,2,"F",0,NULL,0,0,0,0,0}},
-    {"save", {"save",unsupportedCommand,1,"as",0,NULL,0,0,0,0,0}},
-    {"SAVE", {"save",unsupportedCommand,1,"as",0,NULL,0,0,0,0,0}},
-    {"bgsave", {"bgsave",unsupportedCommand,-1,"a",0,NULL,0,0,0,0,0}},
-    {"BGSAVE", {"bgsave",unsupportedCommand,-1,"a",0,NULL,0,0,0,0,0}},
-    {"bgrewriteaof", {"bgrewriteaof",unsupportedCommand,1,"a",0,NULL,0,0,0,0,0}},
-    {"BGREWRITEAOF", {"bgrewriteaof",unsupportedCommand,1,"a",0,NULL,0,0,0,0,0}},
-    {"shutdown", {"shutdown",unsupportedCommand,-1,"alt",0,NULL,0,0,0,0,0}},
-    {"SHUTDOWN", {"shutdown",unsupportedCommand,-1,"alt",0,NULL,0,0,0,0,0}},
-    {"lastsave", {"lastsave",unsupportedCommand,1,"RF",0,NULL,0,0,0,0,0}},
-    {"LASTSAVE", {"lastsave",unsupportedCommand,1,"RF",0,NULL,0,0,0,0,0}},
-    {"type", {"type",unsupportedCommand,2,"rF",0,NULL,1,1,1,0,0}},
-    {"TYPE", {"type",unsupportedCommand,2,"rF",0,NULL,1,1,1,0,0}},
-    {"multi", {"multi",unsupportedCommand,1,"sF",0,NULL,0,0,0,0,0}},
-    {"MULTI", {"multi",unsupportedCommand,1,"sF",0,NULL,0,0,0,0,0}},
-    {"exec", {"exec",unsupportedCommand,1,"sM",0,NULL,0,0,0,0,0}},
-    {"EXEC", {"exec",unsupportedCommand,1,"sM",0,NULL,0,0,0,0,0}},
-    {"discard", {"discard",unsupportedCommand,1,"sF",0,NULL,0,0,0,0,0}},
-    {"DISCARD", {"discard",unsupportedCommand,1,"sF",0,NULL,0,0,0,0,0}},
-    {"sync", {"sync",unsupportedCommand,1,"ars",0,NULL,0,0,0,0,0}},
-    {"SYNC", {"sync",unsupportedCommand,1,"ars",0,NULL,0,0,0,0,0}},
-    {"psync", {"psync",unsupportedCommand,3,"ars",0,NULL,0,0,0,0,0}},
-    {"PSYNC", {"psync",unsupportedCommand,3,"ars",0,NULL,0,0,0,0,0}},
-    {"replconf", {"replconf",unsupportedCommand,-1,"aslt",0,NULL,0,0,0,0,0}},
-    {"REPLCONF", {"replconf",unsupportedCommand,-1,"aslt",0,NULL,0,0,0,0,0}},
-    {"flushdb", {"flushdb",unsupportedCommand,1,"w",0,NULL,0,0,0,0,0}},
-    {"FLUSHDB", {"flushdb",unsupportedCommand,1,"w",0,NULL,0,0,0,0,0}},
-    {"flushall", {"flushall",unsupportedCommand,1,"w",0,NULL,0,0,0,0,0}},
-    {"FLUSHALL", {"flushall",unsupportedCommand,1,"w",0,NULL,0,0,0,0,0}},
-    {"sort", {"sort",unsupportedCommand,-2,"wm",0,NULL,1,1,1,0,0}},
-    {"SORT", {"sort",unsupportedCommand,-2,"wm",0,NULL,1,1,1,0,0}},
-    {"info", {"info",unsupportedCommand,-1,"lt",0,NULL,0,0,0,0,0}},
-    {"INFO", {"info",unsupportedCommand,-1,"lt",0,NULL,0,0,0,0,0}},
-    {"monitor", {"monitor",unsupportedCommand,1,"as",0,NULL,0,0,0,0,0}},
-    {"MONITOR", {"monitor",unsupportedCommand,1,"as",0,NULL,0,0,0,0,0}},
-    {"ttl", {"ttl",unsupportedCommand,2,"rF",0,NULL,1,1,1,0,0}},
-    {"TTL", {"ttl",unsupportedCommand,2,"rF",0,NULL,1,1,1,0,0}},
-    {"touch", {"touch",unsupportedCommand,-2,"rF",0,NULL,1,1,1,0,0}},
-    {"TOUCH", {"touch",unsupportedCommand,-2,"rF",0,NULL,1,1,1,0,0}},
-    {"pttl", {"pttl",unsupportedCommand,2,"rF",0,NULL,1,1,1,0,0}},
-    {"PTTL", {"pttl",unsupportedCommand,2,"rF",0,NULL,1,1,1,0,0}},
-    {"persist", {"persist",unsupportedCommand,2,"wF",0,NULL,1,1,1,0,0}},
-    {"PERSIST", {"persist",unsupportedCommand,2,"wF",0,NULL,1,1,1,0,0}},
-    {"slaveof", {"slaveof",unsupportedCommand,3,"ast",0,NULL,0,0,0,0,0}},
-    {"SLAVEOF", {"slaveof",unsupportedCommand,3,"ast",0,NULL,0,0,0,0,0}},
-    {"role", {"role",unsupportedCommand,1,"lst",0,NULL,0,0,0,0,0}},
-    {"ROLE", {"role",unsupportedCommand,1,"lst",0,NULL,0,0,0,0,0}},
-    {"debug", {"debug",unsupportedCommand,-1,"as",0,NULL,0,0,0,0,0}},
-    {"DEBUG", {"debug",unsupportedCommand,-1,"as",0,NULL,0,0,0,0,0}},
-    {"config", {"config",unsupportedCommand,-2,"lat",0,NULL,0,0,0,0,0}},
-    {"CONFIG", {"config",unsupportedCommand,-2,"lat",0,NULL,0,0,0,0,0}},
-    {"subscribe", {"subscribe",unsupportedCommand,-2,"pslt",0,NULL,0,0,0,0,0}},
-    {"SUBSCRIBE", {"subscribe",unsupportedCommand,-2,"pslt",0,NULL,0,0,0,0,0}},
-    {"unsubscribe", {"unsubscribe",unsupportedCommand,-1,"pslt",0,NULL,0,0,0,0,0}},
-    {"UNSUBSCRIBE", {"unsubscribe",unsupportedCommand,-1,"pslt",0,NULL,0,0,0,0,0}},
-    {"psubscribe", {"psubscribe",unsupportedCommand,-2,"pslt",0,NULL,0,0,0,0,0}},
-    {"PSUBSCRIBE", {"psubscribe",unsupportedCommand,-2,"pslt",0,NULL,0,0,0,0,0}},
-    {"punsubscribe", {"punsubscribe",unsupportedCommand,-1,"pslt",0,NULL,0,0,0,0,0}},
-    {"PUNSUBSCRIBE", {"punsubscribe",unsupportedCommand,-1,"pslt",0,NULL,0,0,0,0,0}},
-    {"publish", {"publish",unsupportedCommand,3,"pltF",0,NULL,0,0,0,0,0}},
-    {"PUBLISH", {"publish",unsupportedCommand,3,"pltF",0,NULL,0,0,0,0,0}},
-    {"pubsub", {"pubsub",unsupportedCommand,-2,"pltR",0,NULL,0,0,0,0,0}},
-    {"PUBSUB", {"pubsub",unsupportedCommand,-2,"pltR",0,NULL,0,0,0,0,0}},
-    {"watch", {"watch",unsupportedCommand,-2,"sF",0,NULL,1,-1,1,0,0}},
-    {"WATCH", {"watch",unsupportedCommand,-2,"sF",0,NULL,1,-1,1,0,0}},
-    {"unwatch", {"unwatch",unsupportedCommand,1,"sF",0,NULL,0,0,0,0,0}},
-    {"UNWATCH", {"unwatch",unsupportedCommand,1,"sF",0,NULL,0,0,0,0,0}},
-    {"cluster", {"cluster",unsupportedCommand,-2,"a",0,NULL,0,0,0,0,0}},
-    {"CLUSTER", {"cluster",unsupportedCommand,-2,"a",0,NULL,0,0,0,0,0}},
-    {"restore", {"restore",unsupportedCommand,-4,"wm",0,NULL,1,1,1,0,0}},
-    {"RESTORE", {"restore",unsupportedCommand,-4,"wm",0,NULL,1,1,1,0,0}},
-    {"restore-asking", {"restore-asking",unsupportedCommand,-4,"wmk",0,NULL,1,1,1,0,0}},
-    {"RESTORE-ASKING", {"restore-asking",unsupportedCommand,-4,"wmk",0,NULL,1,1,1,0,0}},
-    {"migrate", {"migrate",unsupportedCommand,-6,"w",0,NULL,0,0,0,0,0}},
-    {"MIGRATE", {"migrate",unsupportedCommand,-6,"w",0,NULL,0,0,0,0,0}},
-    {"asking", {"asking",unsupportedCommand,1,"F",0,NULL,0,0,0,0,0}},
-    {"ASKING", {"asking",unsupportedCommand,1,"F",0,NULL,0,0,0,0,0}},
-    {"readonly", {"readonly",unsupportedCommand,1,"F",0,NULL,0,0,0,0,0}},
-    {"READONLY", {"readonly",unsupportedCommand,1,"F",0,NULL,0,0,0,0,0}},
-    {"readwrite", {"readwrite",unsupportedCommand,1,"F",0,NULL,0,0,0,0,0}},
-    {"READWRITE", {"readwrite",unsupportedCommand,1,"F",0,NULL,0,0,0,0,0}},
-    {"dump", {"dump",unsupportedCommand,2,"r",0,NULL,1,1,1,0,0}},
-    {"DUMP", {"dump",unsupportedCommand,2,"r",0,NULL,1,1,1,0,0}},
-    {"object", {"object",unsupportedCommand,3,"r",0,NULL,2,2,2,0,0}},
-    {"OBJECT", {"object",unsupportedCommand,3,"r",0,NULL,2,2,2,0,0}},
-    {"client", {"client",unsupportedCommand,-2,"as",0,NULL,0,0,0,0,0}},
-    {"CLIENT", {"client",unsupportedCommand,-2,"as",0,NULL,0,0,0,0,0}},
-    {"eval", {"eval",unsupportedCommand,-3,"s",0,NULL,0,0,0,0,0}},
-    {"EVAL", {"eval",unsupportedCommand,-3,"s",0,NULL,0,0,0,0,0}},
-    {"evalsha", {"evalsha",unsupportedCommand,-3,"s",0,NULL,0,0,0,0,0}},
-    {"EVALSHA", {"evalsha",unsupportedCommand,-3,"s",0,NULL,0,0,0,0,0}},
-    {"slowlog", {"slowlog",unsupportedCommand,-2,"a",0,NULL,0,0,0,0,0}},
-    {"SLOWLOG", {"slowlog",unsupportedCommand,-2,"a",0,NULL,0,0,0,0,0}},
-    {"script", {"script",unsupportedCommand,-2,"s",0,NULL,0,0,0,0,0}},
-    {"SCRIPT", {"script",unsupportedCommand,-2,"s",0,NULL,0,0,0,0,0}},
-    {"time", {"time",unsupportedCommand,1,"RF",0,NULL,0,0,0,0,0}},
-    {"TIME", {"time",unsupportedCommand,1,"RF",0,NULL,0,0,0,0,0}},
-    {"bitop", {"bitop",unsupportedCommand,-4,"wm",0,NULL,2,-1,1,0,0}},
-    {"BITOP", {"bitop",unsupportedCommand,-4,"wm",0,NULL,2,-1,1,0,0}},
-    {"bitcount", {"bitcount",unsupportedCommand,-2,"r",0,NULL,1,1,1,0,0}},
-    {"BITCOUNT", {"bitcount",unsupportedCommand,-2,"r",0,NULL,1,1,1,0,0}},
-    {"bitpos", {"bitpos",unsupportedCommand,-3,"r",0,NULL,1,1,1,0,0}},
-    {"BITPOS", {"bitpos",unsupportedCommand,-3,"r",0,NULL,1,1,1,0,0}},
-    {"wait", {"wait",unsupportedCommand,3,"s",0,NULL,0,0,0,0,0}},
-    {"WAIT", {"wait",unsupportedCommand,3,"s",0,NULL,0,0,0,0,0}},
-    {"command", {"command",unsupportedCommand,0,"lt",0,NULL,0,0,0,0,0}},
-    {"COMMAND", {"command",unsupportedCommand,0,"lt",0,NULL,0,0,0,0,0}},
-    {"geoadd", {"geoadd",unsupportedCommand,-5,"wm",0,NULL,1,1,1,0,0}},
-    {"GEOADD", {"geoadd",unsupportedCommand,-5,"wm",0,NULL,1,1,1,0,0}},
-    {"georadius", {"georadius",unsupportedCommand,-6,"w",0,NULL,1,1,1,0,0}},
-    {"GEORADIUS", {"georadius",unsupportedCommand,-6,"w",0,NULL,1,1,1,0,0}},
-    {"georadiusbymember", {"georadiusbymember",unsupportedCommand,-5,"w",0,NULL,1,1,1,0,0}},
-    {"GEORADIUSBYMEMBER", {"georadiusbymember",unsupportedCommand,-5,"w",0,NULL,1,1,1,0,0}},
-    {"geohash", {"geohash",unsupportedCommand,-2,"r",0,NULL,1,1,1,0,0}},
-    {"GEOHASH", {"geohash",unsupportedCommand,-2,"r",0,NULL,1,1,1,0,0}},
-    {"geopos", {"geopos",unsupportedCommand,-2,"r",0,NULL,1,1,1,0,0}},
-    {"GEOPOS", {"geopos",unsupportedCommand,-2,"r",0,NULL,1,1,1,0,0}},
-    {"geodist", {"geodist",unsupportedCommand,-4,"r",0,NULL,1,1,1,0,0}},
-    {"GEODIST", {"geodist",unsupportedCommand,-4,"r",0,NULL,1,1,1,0,0}},
-    {"pfselftest", {"pfselftest",unsupportedCommand,1,"a",0,NULL,0,0,0,0,0}},
-    {"PFSELFTEST", {"pfselftest",unsupportedCommand,1,"a",0,NULL,0,0,0,0,0}},
-    {"pfadd", {"pfadd",unsupportedCommand,-2,"wmF",0,NULL,1,1,1,0,0}},
-    {"PFADD", {"pfadd",unsupportedCommand,-2,"wmF",0,NULL,1,1,1,0,0}},
-    {"pfcount", {"pfcount",unsupportedCommand,-2,"r",0,NULL,1,-1,1,0,0}},
-    {"PFCOUNT", {"pfcount",unsupportedCommand,-2,"r",0,NULL,1,-1,1,0,0}},
-    {"pfmerge", {"pfmerge",unsupportedCommand,-2,"wm",0,NULL,1,-1,1,0,0}},
-    {"PFMERGE", {"pfmerge",unsupportedCommand,-2,"wm",0,NULL,1,-1,1,0,0}},
-    {"pfdebug", {"pfdebug",unsupportedCommand,-3,"w",0,NULL,0,0,0,0,0}},
-    {"PFDEBUG", {"pfdebug",unsupportedCommand,-3,"w",0,NULL,0,0,0,0,0}},
-    {"latency", {"latency",unsupportedCommand,-2,"aslt",0,NULL,0,0,0,0,0}},
-    {"LATENCY", {"latency",unsupportedCommand,-2,"aslt",0,NULL,0,0,0,0,0}}
+struct redisCommand redisCommandTable[] = {
+    {"get",getCommand,2,"rF",0,NULL,1,1,1,0,0},
+    {"set",setCommand,-3,"wm",0,NULL,1,1,1,0,0},
+    {"setnx",unsupportedCommand,3,"wmF",0,NULL,1,1,1,0,0},
+    {"setex",unsupportedCommand,4,"wm",0,NULL,1,1,1,0,0},
+    {"psetex",unsupportedCommand,4,"wm",0,NULL,1,1,1,0,0},
+    {"append",unsupportedCommand,3,"wm",0,NULL,1,1,1,0,0},
+    {"strlen",unsupportedCommand,2,"rF",0,NULL,1,1,1,0,0},
+    {"del",unsupportedCommand,-2,"w",0,NULL,1,-1,1,0,0},
+    {"exists",unsupportedCommand,-2,"rF",0,NULL,1,-1,1,0,0},
+    {"setbit",unsupportedCommand,4,"wm",0,NULL,1,1,1,0,0},
+    {"getbit",unsupportedCommand,3,"rF",0,NULL,1,1,1,0,0},
+    {"bitfield",unsupportedCommand,-2,"wm",0,NULL,1,1,1,0,0},
+    {"setrange",unsupportedCommand,4,"wm",0,NULL,1,1,1,0,0},
+    {"getrange",unsupportedCommand,4,"r",0,NULL,1,1,1,0,0},
+    {"substr",unsupportedCommand,4,"r",0,NULL,1,1,1,0,0},
+    {"incr",incrCommand,2,"wmF",0,NULL,1,1,1,0,0},
+    {"decr",unsupportedCommand,2,"wmF",0,NULL,1,1,1,0,0},
+    {"mget",mgetCommand,-2,"r",0,NULL,1,-1,1,0,0},
+    {"rpush",rpushCommand,-3,"wm",0,NULL,1,1,1,0,0},
+    {"lpush",lpushCommand,-3,"wm",0,NULL,1,1,1,0,0},
+    {"rpushx",unsupportedCommand,3,"wm",0,NULL,1,1,1,0,0},
+    {"lpushx",unsupportedCommand,3,"wm",0,NULL,1,1,1,0,0},
+    {"linsert",unsupportedCommand,5,"wm",0,NULL,1,1,1,0,0},
+    {"rpop",rpopCommand,2,"wT",0,NULL,1,1,1,0,0},
+    {"lpop",lpopCommand,2,"wT",0,NULL,1,1,1,0,0},
+    {"brpop",unsupportedCommand,-3,"ws",0,NULL,1,1,1,0,0},
+    {"brpoplpush",unsupportedCommand,4,"wms",0,NULL,1,2,1,0,0},
+    {"blpop",unsupportedCommand,-3,"ws",0,NULL,1,-2,1,0,0},
+    {"llen",llenCommand,2,"rF",0,NULL,1,1,1,0,0},
+    {"lindex",lindexCommand,3,"rT",0,NULL,1,1,1,0,0},
+    {"lset",lsetCommand,4,"wmT",0,NULL,1,1,1,0,0},
+    {"lrange",lrangeCommand,4,"rT",0,NULL,1,1,1,0,0},
+    {"ltrim",unsupportedCommand,4,"w",0,NULL,1,1,1,0,0},
+    {"lrem",unsupportedCommand,4,"w",0,NULL,1,1,1,0,0},
+    {"rpoplpush",unsupportedCommand,3,"wm",0,NULL,1,2,1,0,0},
+    {"sadd",unsupportedCommand,-3,"wmF",0,NULL,1,1,1,0,0},
+    {"srem",unsupportedCommand,-3,"wF",0,NULL,1,1,1,0,0},
+    {"smove",unsupportedCommand,4,"wF",0,NULL,1,2,1,0,0},
+    {"sismember",unsupportedCommand,3,"rF",0,NULL,1,1,1,0,0},
+    {"scard",unsupportedCommand,2,"rF",0,NULL,1,1,1,0,0},
+    {"spop",unsupportedCommand,-2,"wRF",0,NULL,1,1,1,0,0},
+    {"srandmember",unsupportedCommand,-2,"rR",0,NULL,1,1,1,0,0},
+    {"sinter",unsupportedCommand,-2,"rS",0,NULL,1,-1,1,0,0},
+    {"sinterstore",unsupportedCommand,-3,"wm",0,NULL,1,-1,1,0,0},
+    {"sunion",unsupportedCommand,-2,"rS",0,NULL,1,-1,1,0,0},
+    {"sunionstore",unsupportedCommand,-3,"wm",0,NULL,1,-1,1,0,0},
+    {"sdiff",unsupportedCommand,-2,"rS",0,NULL,1,-1,1,0,0},
+    {"sdiffstore",unsupportedCommand,-3,"wm",0,NULL,1,-1,1,0,0},
+    {"smembers",unsupportedCommand,2,"rS",0,NULL,1,1,1,0,0},
+    {"sscan",unsupportedCommand,-3,"rR",0,NULL,1,1,1,0,0},
+    {"zadd",unsupportedCommand,-4,"wmF",0,NULL,1,1,1,0,0},
+    {"zincrby",unsupportedCommand,4,"wmF",0,NULL,1,1,1,0,0},
+    {"zrem",unsupportedCommand,-3,"wF",0,NULL,1,1,1,0,0},
+    {"zremrangebyscore",unsupportedCommand,4,"w",0,NULL,1,1,1,0,0},
+    {"zremrangebyrank",unsupportedCommand,4,"w",0,NULL,1,1,1,0,0},
+    {"zremrangebylex",unsupportedCommand,4,"w",0,NULL,1,1,1,0,0},
+    {"zunionstore",unsupportedCommand,-4,"wm",0,NULL,0,0,0,0,0},
+    {"zinterstore",unsupportedCommand,-4,"wm",0,NULL,0,0,0,0,0},
+    {"zrange",unsupportedCommand,-4,"r",0,NULL,1,1,1,0,0},
+    {"zrangebyscore",unsupportedCommand,-4,"r",0,NULL,1,1,1,0,0},
+    {"zrevrangebyscore",unsupportedCommand,-4,"r",0,NULL,1,1,1,0,0},
+    {"zrangebylex",unsupportedCommand,-4,"r",0,NULL,1,1,1,0,0},
+    {"zrevrangebylex",unsupportedCommand,-4,"r",0,NULL,1,1,1,0,0},
+    {"zcount",unsupportedCommand,4,"rF",0,NULL,1,1,1,0,0},
+    {"zlexcount",unsupportedCommand,4,"rF",0,NULL,1,1,1,0,0},
+    {"zrevrange",unsupportedCommand,-4,"r",0,NULL,1,1,1,0,0},
+    {"zcard",unsupportedCommand,2,"rF",0,NULL,1,1,1,0,0},
+    {"zscore",unsupportedCommand,3,"rF",0,NULL,1,1,1,0,0},
+    {"zrank",unsupportedCommand,3,"rF",0,NULL,1,1,1,0,0},
+    {"zrevrank",unsupportedCommand,3,"rF",0,NULL,1,1,1,0,0},
+    {"zscan",unsupportedCommand,-3,"rR",0,NULL,1,1,1,0,0},
+    {"hset",unsupportedCommand,4,"wmF",0,NULL,1,1,1,0,0},
+    {"hsetnx",unsupportedCommand,4,"wmF",0,NULL,1,1,1,0,0},
+    {"hget",unsupportedCommand,3,"rF",0,NULL,1,1,1,0,0},
+    {"hmset",unsupportedCommand,-4,"wm",0,NULL,1,1,1,0,0},
+    {"hmget",unsupportedCommand,-3,"r",0,NULL,1,1,1,0,0},
+    {"hincrby",unsupportedCommand,4,"wmF",0,NULL,1,1,1,0,0},
+    {"hincrbyfloat",unsupportedCommand,4,"wmF",0,NULL,1,1,1,0,0},
+    {"hdel",unsupportedCommand,-3,"wF",0,NULL,1,1,1,0,0},
+    {"hlen",unsupportedCommand,2,"rF",0,NULL,1,1,1,0,0},
+    {"hstrlen",unsupportedCommand,3,"rF",0,NULL,1,1,1,0,0},
+    {"hkeys",unsupportedCommand,2,"rS",0,NULL,1,1,1,0,0},
+    {"hvals",unsupportedCommand,2,"rS",0,NULL,1,1,1,0,0},
+    {"hgetall",unsupportedCommand,2,"r",0,NULL,1,1,1,0,0},
+    {"hexists",unsupportedCommand,3,"rF",0,NULL,1,1,1,0,0},
+    {"hscan",unsupportedCommand,-3,"rR",0,NULL,1,1,1,0,0},
+    {"incrby",unsupportedCommand,3,"wmF",0,NULL,1,1,1,0,0},
+    {"decrby",unsupportedCommand,3,"wmF",0,NULL,1,1,1,0,0},
+    {"incrbyfloat",unsupportedCommand,3,"wmF",0,NULL,1,1,1,0,0},
+    {"getset",unsupportedCommand,3,"wm",0,NULL,1,1,1,0,0},
+    {"mset",msetCommand,-3,"wm",0,NULL,1,-1,2,0,0},
+    {"msetnx",unsupportedCommand,-3,"wm",0,NULL,1,-1,2,0,0},
+    {"randomkey",unsupportedCommand,1,"rR",0,NULL,0,0,0,0,0},
+    {"select",unsupportedCommand,2,"lF",0,NULL,0,0,0,0,0},
+    {"move",unsupportedCommand,3,"wF",0,NULL,1,1,1,0,0},
+    {"rename",unsupportedCommand,3,"w",0,NULL,1,2,1,0,0},
+    {"renamenx",unsupportedCommand,3,"wF",0,NULL,1,2,1,0,0},
+    {"expire",unsupportedCommand,3,"wF",0,NULL,1,1,1,0,0},
+    {"expireat",unsupportedCommand,3,"wF",0,NULL,1,1,1,0,0},
+    {"pexpire",unsupportedCommand,3,"wF",0,NULL,1,1,1,0,0},
+    {"pexpireat",unsupportedCommand,3,"wF",0,NULL,1,1,1,0,0},
+    {"keys",unsupportedCommand,2,"rS",0,NULL,0,0,0,0,0},
+    {"scan",unsupportedCommand,-2,"rR",0,NULL,0,0,0,0,0},
+    {"dbsize",unsupportedCommand,1,"rF",0,NULL,0,0,0,0,0},
+    {"auth",unsupportedCommand,2,"sltF",0,NULL,0,0,0,0,0},
+    {"ping",unsupportedCommand,-1,"tF",0,NULL,0,0,0,0,0},
+    {"echo",unsupportedCommand,2,"F",0,NULL,0,0,0,0,0},
+    {"save",unsupportedCommand,1,"as",0,NULL,0,0,0,0,0},
+    {"bgsave",unsupportedCommand,-1,"a",0,NULL,0,0,0,0,0},
+    {"bgrewriteaof",unsupportedCommand,1,"a",0,NULL,0,0,0,0,0},
+    {"shutdown",unsupportedCommand,-1,"alt",0,NULL,0,0,0,0,0},
+    {"lastsave",unsupportedCommand,1,"RF",0,NULL,0,0,0,0,0},
+    {"type",unsupportedCommand,2,"rF",0,NULL,1,1,1,0,0},
+    {"multi",unsupportedCommand,1,"sF",0,NULL,0,0,0,0,0},
+    {"exec",unsupportedCommand,1,"sM",0,NULL,0,0,0,0,0},
+    {"discard",unsupportedCommand,1,"sF",0,NULL,0,0,0,0,0},
+    {"sync",unsupportedCommand,1,"ars",0,NULL,0,0,0,0,0},
+    {"psync",unsupportedCommand,3,"ars",0,NULL,0,0,0,0,0},
+    {"replconf",unsupportedCommand,-1,"aslt",0,NULL,0,0,0,0,0},
+    {"flushdb",unsupportedCommand,1,"w",0,NULL,0,0,0,0,0},
+    {"flushall",unsupportedCommand,1,"w",0,NULL,0,0,0,0,0},
+    {"sort",unsupportedCommand,-2,"wm",0,NULL,1,1,1,0,0},
+    {"info",infoCommand,-1,"lt",0,NULL,0,0,0,0,0},
+    {"monitor",unsupportedCommand,1,"as",0,NULL,0,0,0,0,0},
+    {"ttl",unsupportedCommand,2,"rF",0,NULL,1,1,1,0,0},
+    {"touch",unsupportedCommand,-2,"rF",0,NULL,1,1,1,0,0},
+    {"pttl",unsupportedCommand,2,"rF",0,NULL,1,1,1,0,0},
+    {"persist",unsupportedCommand,2,"wF",0,NULL,1,1,1,0,0},
+    {"slaveof",unsupportedCommand,3,"ast",0,NULL,0,0,0,0,0},
+    {"role",unsupportedCommand,1,"lst",0,NULL,0,0,0,0,0},
+    {"debug",debugCommand,-2,"as",0,NULL,0,0,0,0,0},
+    {"config",unsupportedCommand,-2,"lat",0,NULL,0,0,0,0,0},
+    {"subscribe",unsupportedCommand,-2,"pslt",0,NULL,0,0,0,0,0},
+    {"unsubscribe",unsupportedCommand,-1,"pslt",0,NULL,0,0,0,0,0},
+    {"psubscribe",unsupportedCommand,-2,"pslt",0,NULL,0,0,0,0,0},
+    {"punsubscribe",unsupportedCommand,-1,"pslt",0,NULL,0,0,0,0,0},
+    {"publish",unsupportedCommand,3,"pltF",0,NULL,0,0,0,0,0},
+    {"pubsub",unsupportedCommand,-2,"pltR",0,NULL,0,0,0,0,0},
+    {"watch",unsupportedCommand,-2,"sF",0,NULL,1,-1,1,0,0},
+    {"unwatch",unsupportedCommand,1,"sF",0,NULL,0,0,0,0,0},
+    {"cluster",unsupportedCommand,-2,"a",0,NULL,0,0,0,0,0},
+    {"restore",unsupportedCommand,-4,"wm",0,NULL,1,1,1,0,0},
+    {"restore-asking",unsupportedCommand,-4,"wmk",0,NULL,1,1,1,0,0},
+    {"migrate",unsupportedCommand,-6,"w",0,NULL,0,0,0,0,0},
+    {"asking",unsupportedCommand,1,"F",0,NULL,0,0,0,0,0},
+    {"readonly",unsupportedCommand,1,"F",0,NULL,0,0,0,0,0},
+    {"readwrite",unsupportedCommand,1,"F",0,NULL,0,0,0,0,0},
+    {"dump",unsupportedCommand,2,"r",0,NULL,1,1,1,0,0},
+    {"object",unsupportedCommand,3,"r",0,NULL,2,2,2,0,0},
+    {"client",clientCommand,-2,"as",0,NULL,0,0,0,0,0},
+    {"eval",unsupportedCommand,-3,"s",0,NULL,0,0,0,0,0},
+    {"evalsha",unsupportedCommand,-3,"s",0,NULL,0,0,0,0,0},
+    {"slowlog",slowlogCommand,-2,"a",0,NULL,0,0,0,0,0},
+    {"script",unsupportedCommand,-2,"s",0,NULL,0,0,0,0,0},
+    {"time",unsupportedCommand,1,"RF",0,NULL,0,0,0,0,0},
+    {"bitop",unsupportedCommand,-4,"wm",0,NULL,2,-1,1,0,0},
+    {"bitcount",unsupportedCommand,-2,"r",0,NULL,1,1,1,0,0},
+    {"bitpos",unsupportedCommand,-3,"r",0,NULL,1,1,1,0,0},
+    {"wait",unsupportedCommand,3,"s",0,NULL,0,0,0,0,0},
+    {"command",unsupportedCommand,0,"lt",0,NULL,0,0,0,0,0},
+    {"geoadd",unsupportedCommand,-5,"wm",0,NULL,1,1,1,0,0},
+    {"georadius",unsupportedCommand,-6,"w",0,NULL,1,1,1,0,0},
+    {"georadiusbymember",unsupportedCommand,-5,"w",0,NULL,1,1,1,0,0},
+    {"geohash",unsupportedCommand,-2,"r",0,NULL,1,1,1,0,0},
+    {"geopos",unsupportedCommand,-2,"r",0,NULL,1,1,1,0,0},
+    {"geodist",unsupportedCommand,-4,"r",0,NULL,1,1,1,0,0},
+    {"pfselftest",unsupportedCommand,1,"a",0,NULL,0,0,0,0,0},
+    {"pfadd",unsupportedCommand,-2,"wmF",0,NULL,1,1,1,0,0},
+    {"pfcount",unsupportedCommand,-2,"r",0,NULL,1,-1,1,0,0},
+    {"pfmerge",unsupportedCommand,-2,"wm",0,NULL,1,-1,1,0,0},
+    {"pfdebug",unsupportedCommand,-3,"w",0,NULL,0,0,0,0,0},
+    {"latency",latencyCommand,-2,"aslt",0,NULL,0,0,0,0,0}
 };
 
+/* Commands are found through a perfect hash table over their names, built by
+ * populateCommandTable(). Names are hashed case insensitively, with a seed
+ * picked at startup so that no two commands share a slot. A lookup is then
+ * one hash and one name comparison, with no allocation. */
+#define COMMAND_HASH_SLOTS 4096 /* Must be a power of two */
+static_assert(sizeof(redisCommandTable)/sizeof(redisCommandTable[0]) < 256,
+    "commandSlots entries are one byte");
+static uint8_t commandSlots[COMMAND_HASH_SLOTS]; /* Table index + 1, or 0 */
+static uint32_t commandHashSeed;
+
+/* FNV-1a of the name with ASCII letters folded to lower case. Folds a few
+ * non-letters too, but lookupCommand() compares the name anyway. */
+static inline uint32_t commandHash(const char *name, size_t len,
+    uint32_t seed) {
+  uint32_t h = seed;
+  for (size_t i = 0; i < len; i++)
+    h = (h ^ (uint8_t)(name[i] | 0x20)) * 16777619u;
+  return h;
+}
+
+/* Populates the command table's flags from the sflags strings, and builds
+ * the hash table used by lookupCommand(). */
+void populateCommandTable(void) {
+    int j;
+    int numcommands = sizeof(redisCommandTable)/sizeof(struct redisCommand);
+
+    for (j = 0; j < numcommands; j++) {
+        struct redisCommand *c = redisCommandTable+j;
+        const char *f = c->sflags;
+
+        while(*f != '\0') {
+            switch(*f) {
+            case 'w': c->flags |= CMD_WRITE; break;
+            case 'r': c->flags |= CMD_READONLY; break;
+            case 'm': c->flags |= CMD_DENYOOM; break;
+            case 'f': c->flags |= CMD_FORCE_REPLICATION; break;
+            case 'a': c->flags |= CMD_ADMIN; break;
+            case 'p': c->flags |= CMD_PUBSUB; break;
+            case 's': c->flags |= CMD_NOSCRIPT; break;
+            case 'R': c->flags |= CMD_RANDOM; break;
+            case 'S': c->flags |= CMD_SORT_FOR_SCRIPT; break;
+            case 'l': c->flags |= CMD_LOADING; break;
+            case 't': c->flags |= CMD_STALE; break;
+            case 'M': c->flags |= CMD_SKIP_MONITOR; break;
+            case 'k': c->flags |= CMD_ASKING; break;
+            case 'F': c->flags |= CMD_FAST; break;
+            case 'T': c->flags |= CMD_TRANSACTION; break;
+            default:
+                serverLog(LL_ERROR, "Unsupported command flag '%c' for '%s'",
+                    *f, c->name);
+                exit(1);
+            }
+            f++;
+        }
+    }
+
+    /* Try seeds until every command lands in a slot of its own. With a table
+     * this sparse that takes a few dozen tries. */
+    for (uint32_t seed = 2166136261u; ; seed++) {
+        memset(commandSlots, 0, sizeof(commandSlots));
+        for (j = 0; j < numcommands; j++) {
+            const char *name = redisCommandTable[j].name;
+            uint32_t slot = commandHash(name, strlen(name), seed) &
+                (COMMAND_HASH_SLOTS-1);
+            if (commandSlots[slot]) break;
+            commandSlots[slot] = j+1;
+        }
+        if (j == numcommands) {
+            commandHashSeed = seed;
+            break;
+        }
+    }
+
+    serverLog(LL_DEBUG, "Command table: %d commands, hash seed %u",
+        numcommands, commandHashSeed);
+}
+
+/* The number of commands in the command table. */
+int commandCount() {
+  return sizeof(redisCommandTable)/sizeof(struct redisCommand);
+}
+
+/* Look up a command by name, ignoring case. Returns NULL if there is no such
+ * command. */
+struct redisCommand *lookupCommand(const char *name, size_t len) {
+  uint8_t idx = commandSlots[commandHash(name, len, commandHashSeed) &
+      (COMMAND_HASH_SLOTS-1)];
+  if (idx == 0)
+    return NULL;
+
+  struct redisCommand *cmd = &redisCommandTable[idx-1];
+  if (strlen(cmd->name) != len || strncasecmp(cmd->name, name, len) != 0)
+    return NULL;
+  return cmd;
+}
+
 void serverLog(int level, const char *fmt, ...) {
   va_list ap;
   char msg[LOG_MAX_LEN];
@@ -523,6 +506,244 @@ int string2ll(const char *s, size_t slen, long long *value) {
     return 1;
 }
 
+/* Collect the distinct keys of a request, using the first key, last key and
+ * key step of its command table entry. Unknown commands and requests with the
+ * wrong number of arguments have no keys, they only get an error reply. */
+void getKeysFromCommand(const redisCommand *cmd,
+    const std::vector<argView> &argv, std::vector<std::string> *keys) {
+  if (cmd == NULL)
+    return;
+
+  int argc = argv.size();
+  if ((cmd->arity > 0 && cmd->arity != argc) || (argc < -cmd->arity) ||
+      cmd->firstkey == 0)
+    return;
+
+  int last = cmd->lastkey < 0 ? argc + cmd->lastkey : cmd->lastkey;
+  for (int j = cmd->firstkey; j <= last && j < argc; j += cmd->keystep) {
+    std::string key = argv[j].str();
+    if (std::find(keys->begin(), keys->end(), key) == keys->end())
+      keys->push_back(std::move(key));
+  }
+}
+
+/* Plain GETs and SETs can be run together as one multi-object RPC. */
+static bool isBatchable(const request &req) {
+  if (req.cmd == NULL || req.batchSize != 1)
+    return false;
+  return (req.cmd->proc == getCommand && req.argv.size() == 2) ||
+         (req.cmd->proc == setCommand && req.argv.size() == 3);
+}
+
+/* Fold the ready requests that directly follow the first ready request in the
+ * pipeline into it, for as long as they are the same batchable command, up to
+ * max requests in all. Every one of them was ready, so none shares a key with
+ * another, and they may as well run at once. The folded requests count as
+ * dispatched from here on; the executor answers them along with the first
+ * one. */
+static void batchReadyRequests(clientBuffer *c, size_t max) {
+  uint64_t seq = c->readyQ.front();
+  request &first = c->pipeline[seq - c->pipelineBase].req;
+  if (!isBatchable(first))
+    return;
+
+  size_t n = 1;
+  while (n < c->readyQ.size() && n < REQUEST_BATCH_MAX && n < max &&
+         c->readyQ[n] == seq + n) {
+    pipelineEntry &e = c->pipeline[seq + n - c->pipelineBase];
+    if (e.req.cmd != first.cmd || !isBatchable(e.req))
+      break;
+    first.argv.insert(first.argv.end(), e.req.argv.begin(),
+        e.req.argv.end());
+    for (auto& buf : e.req.bufs) {
+      if (first.bufs.empty() || first.bufs.back() != buf)
+        first.bufs.push_back(std::move(buf));
+    }
+    e.req = request();
+    e.state = PIPELINE_DISPATCHED;
+    n++;
+  }
+
+  first.batchSize = n;
+  c->readyQ.erase(c->readyQ.begin() + 1, c->readyQ.begin() + n);
+}
+
+/* 64 bit FNV-1a. */
+static inline uint64_t keyHash(const argView &key) {
+  uint64_t h = 14695981039346656037ULL;
+  for (size_t i = 0; i < key.length(); i++) {
+    h ^= (unsigned char)key.data()[i];
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+/* Commands flagged CMD_FAST take the fast lane, and so do requests that only
+ * get an error reply. */
+static int requestLane(const request &req) {
+  if (req.cmd == NULL || (req.cmd->flags & CMD_FAST))
+    return LANE_FAST;
+  return LANE_SLOW;
+}
+
+/* The queue of the executor that should run a request. With per-executor
+ * queues, requests go to the executor their first key hashes to, so that
+ * requests on the same key run one after the other on the same thread. A
+ * batch goes by the first key of its first request. Requests without keys
+ * are spread by client. */
+static mpmcQueue<request> *requestQueueFor(const request &req) {
+  if (fastQ != NULL)
+    return requestLane(req) == LANE_FAST ? fastQ : slowQ;
+  if (executorQs.empty())
+    return requestQ;
+
+  redisCommand *cmd = req.cmd;
+  uint64_t h;
+  if (cmd != NULL && cmd->firstkey > 0 && (int)req.argv.size() > cmd->firstkey)
+    h = keyHash(req.argv[cmd->firstkey]);
+  else
+    h = req.clientId;
+  return executorQs[h % executorQs.size()];
+}
+
+/* Put a client with ready requests on the reactor's list of clients to
+ * dispatch requests for. */
+void scheduleClient(clientBuffer *c) {
+  if (c->readyQ.empty() || c->inReadyClients || c->closeAsap)
+    return;
+  c->inReadyClients = true;
+  c->loop->readyClients.push_back(c->fd);
+}
+
+/* Hand the client's ready requests to the executors, oldest first, for as
+ * long as its deficit covers them and it is under the in-flight limit. A
+ * batch costs as much as the requests in it. Returns DISPATCH_FULL if the
+ * request queue filled up, in which case the client also stops parsing input
+ * until its ready requests are gone. */
+static int dispatchReadyRequests(clientBuffer *c) {
+  while (!c->readyQ.empty()) {
+    size_t room = REQUEST_BATCH_MAX;
+    if (clientMaxInflight != 0) {
+      if (c->inflight >= clientMaxInflight)
+        return DISPATCH_LIMIT;
+      room = clientMaxInflight - c->inflight;
+    }
+    batchReadyRequests(c, room);
+    pipelineEntry &e = c->pipeline[c->readyQ.front() - c->pipelineBase];
+    uint32_t cost = e.req.batchSize;
+    if (cost > c->deficit)
+      return DISPATCH_DEFICIT;
+
+    mpmcQueue<request> *q = requestQueueFor(e.req);
+    e.req.times.queuedAt = RAMCloud::Cycles::rdtsc();
+    if (!q->tryEnqueue(std::move(e.req))) {
+      c->readPaused = true;
+      return DISPATCH_FULL;
+    }
+    /* Executors that take both lanes may be the only ones asleep. */
+    if (q == fastQ)
+      slowEvents.notify();
+    e.state = PIPELINE_DISPATCHED;
+    c->readyQ.pop_front();
+    c->deficit -= cost;
+    c->inflight += cost;
+  }
+  return DISPATCH_DONE;
+}
+
+/* A held request may run once it is the oldest outstanding request on every
+ * one of its keys. */
+void promoteIfRunnable(clientBuffer *c, uint64_t seq) {
+  pipelineEntry &e = c->pipeline[seq - c->pipelineBase];
+  if (e.state != PIPELINE_HELD)
+    return;
+  for (auto const& key : e.keys) {
+    if (c->keyWaiters[key].front() != seq)
+      return;
+  }
+  e.state = PIPELINE_READY;
+  c->readyQ.push_back(seq);
+}
+
+/* Add the request just parsed into c->argv to the client's pipeline. It is
+ * ready to run unless an earlier request on one of the same keys is still
+ * outstanding. Ready requests are dispatched once the input at hand has been
+ * parsed, so that runs of them can be batched. */
+void submitCommand(clientBuffer *c) {
+  uint64_t seq = c->pipelineBase + c->pipeline.size();
+  c->pipeline.emplace_back();
+  pipelineEntry &e = c->pipeline.back();
+  redisCommand *cmd = lookupCommand(c->argv[0].data(), c->argv[0].length());
+  getKeysFromCommand(cmd, c->argv, &e.keys);
+  e.req = request(c->loop, c->fd, c->id, seq, cmd, std::move(c->argv),
+      std::move(c->argvBufs));
+  e.req.times.parsedAt = RAMCloud::Cycles::rdtsc();
+
+  /* Commands that only look at the server are let in even when it is
+   * overloaded. */
+  bool admit = true;
+  if (admissionEnabled() && admissionAction() == ADMIT_BUSY &&
+      (cmd == NULL || !(cmd->flags & (CMD_ADMIN | CMD_STALE)))) {
+    admit = !admissionOverloaded();
+    admissionCount(admit);
+  }
+
+  if (admit) {
+    for (auto const& key : e.keys)
+      c->keyWaiters[key].push_back(seq);
+    promoteIfRunnable(c, seq);
+  } else {
+    e.keys.clear();
+    e.req = request();
+    e.reply = BUSY_ERR "\r\n";
+    e.state = PIPELINE_DONE;
+  }
+
+  if (c->pipeline.size() >= PIPELINE_MAX_PENDING)
+    c->readPaused = true;
+}
+
+/* Record the reply to a request and make the next request waiting on each of
+ * its keys ready. */
+void completeRequest(clientBuffer *c, uint64_t seq, std::string &&reply) {
+  pipelineEntry &e = c->pipeline[seq - c->pipelineBase];
+  if (e.reply.empty())
+    e.reply = std::move(reply);
+  else
+    e.reply.append(reply);
+  e.state = PIPELINE_DONE;
+
+  for (auto const& key : e.keys) {
+    auto it = c->keyWaiters.find(key);
+    it->second.pop_front();
+    if (it->second.empty())
+      c->keyWaiters.erase(it);
+    else
+      promoteIfRunnable(c, it->second.front());
+  }
+  e.keys.clear();
+}
+
+/* Move the unparsed part of the client's query buffer to the start of a
+ * buffer with room for at least size bytes. Requests that point into the
+ * parsed part hold a reference to the buffer. If there are any, the unparsed
+ * part is copied to a new buffer and they keep the old one alive for as long
+ * as they need it. Otherwise the buffer is trimmed and grown in place. */
+void resizeQueryBuffer(clientBuffer *c, size_t size) {
+  sds qb = c->querybuf->buf;
+  size_t unparsed = sdslen(qb) - c->qb_pos;
+  size_t addlen = size > unparsed ? size - unparsed : 0;
+  if (c->querybuf.use_count() == 1) {
+    if (c->qb_pos)
+      sdsrange(qb, c->qb_pos, -1);
+    c->querybuf->buf = sdsMakeRoomFor(qb, addlen);
+  } else {
+    sds nb = sdsMakeRoomFor(sdsnewlen(qb + c->qb_pos, unparsed), addlen);
+    c->querybuf = std::make_shared<queryBuffer>(nb);
+  }
+  c->qb_pos = 0;
+}
+
 int processInlineBuffer(clientBuffer *c) {
     serverLog(LL_ERROR, "ProcessInlineBuffer: Not Implemented");
 
@@ -587,18 +808,20 @@ int processInlineBuffer(clientBuffer *c) {
 }
 
 /* Parse client buffers for request arguments. Partial results are stored in
- * c->agv. When a full request is parsed from the buffer, then it is enqueued
+ * c->argv. When a full request is parsed from the buffer, then it is enqueued
  * in the request queue for later execution. */
 int processMultibulkBuffer(clientBuffer *c) {
+    sds querybuf = c->querybuf->buf;
     char *newline = NULL;
-    int pos = 0, ok;
+    size_t pos = c->qb_pos;
+    int ok;
     long long ll;
 
     if (c->multibulklen == 0) {
         /* Multi bulk length cannot be read without a \r\n */
-        newline = strchr(c->querybuf,'\r');
+        newline = strchr(querybuf+pos,'\r');
         if (newline == NULL) {
-            if (sdslen(c->querybuf) > PROTO_INLINE_MAX_SIZE) {
+            if (sdslen(querybuf)-pos > PROTO_INLINE_MAX_SIZE) {
                 serverLog(LL_ERROR, 
                     "Protocol error: too big mbulk count string");
                 exit(1);
@@ -607,39 +830,37 @@ int processMultibulkBuffer(clientBuffer *c) {
         }
 
         /* Buffer should also contain \n */
-        if (newline-(c->querybuf) > ((signed)sdslen(c->querybuf)-2))
+        if (newline-(querybuf) > ((signed)sdslen(querybuf)-2))
             return C_ERR;
 
         /* We know for sure there is a whole line since newline != NULL,
          * so go ahead and find out the multi bulk length. */
-        ok = string2ll(c->querybuf+1,newline-(c->querybuf+1),&ll);
+        ok = string2ll(querybuf+pos+1,newline-(querybuf+pos+1),&ll);
         if (!ok || ll > 1024*1024) {
             serverLog(LL_ERROR, 
                     "Protocol error: invalid multibulk length");
             exit(1);
         }
 
-        pos = (newline-c->querybuf)+2;
+        pos = (newline-querybuf)+2;
         if (ll <= 0) {
-            sdsrange(c->querybuf,pos,-1);
+            c->qb_pos = pos;
             return C_OK;
         }
 
         c->multibulklen = ll;
 
         /* Setup argv array on client structure */
-        if (c->argv.size() > 0) {
-            c->argv.clear();
-            c->argv.reserve(ll);
-        }
+        c->argv.clear();
+        c->argv.reserve(ll);
     }
 
     while(c->multibulklen) {
         /* Read bulk length if unknown */
         if (c->bulklen == -1) {
-            newline = strchr(c->querybuf+pos,'\r');
+            newline = strchr(querybuf+pos,'\r');
             if (newline == NULL) {
-                if (sdslen(c->querybuf) > PROTO_INLINE_MAX_SIZE) {
+                if (sdslen(querybuf)-pos > PROTO_INLINE_MAX_SIZE) {
                     serverLog(LL_ERROR, 
                         "Protocol error: too big bulk count string");
                     exit(1);
@@ -648,33 +869,46 @@ int processMultibulkBuffer(clientBuffer *c) {
             }
 
             /* Buffer should also contain \n */
-            if (newline-(c->querybuf) > ((signed)sdslen(c->querybuf)-2))
+            if (newline-(querybuf) > ((signed)sdslen(querybuf)-2))
                 break;
 
-            if (c->querybuf[pos] != '$') {
+            if (querybuf[pos] != '$') {
                 serverLog(LL_ERROR, 
                     "Protocol error: expected '$', got '%c'",
-                    c->querybuf[pos]);
+                    querybuf[pos]);
                 exit(1);
             }
 
-            ok = string2ll(c->querybuf+pos+1,newline-(c->querybuf+pos+1),&ll);
+            ok = string2ll(querybuf+pos+1,newline-(querybuf+pos+1),&ll);
             if (!ok || ll < 0 || ll > 512*1024*1024) {
                 serverLog(LL_ERROR, 
                     "Protocol error: invalid bulk length");
                 exit(1);
             }
 
-            pos += newline-(c->querybuf+pos)+2;
+            pos += newline-(querybuf+pos)+2;
+            if (ll >= PROTO_MBULK_BIG_ARG &&
+                sdslen(querybuf)-pos < (size_t)(ll+2)) {
+                /* Read big arguments straight into a query buffer of their
+                 * own, sized to fit, instead of growing this one a bit at a
+                 * time. The argument then starts at the buffer's start. */
+                c->qb_pos = pos;
+                resizeQueryBuffer(c,ll+2);
+                querybuf = c->querybuf->buf;
+                pos = 0;
+            }
             c->bulklen = ll;
         }
 
         /* Read bulk argument */
-        if (sdslen(c->querybuf)-pos < (unsigned)(c->bulklen+2)) {
+        if (sdslen(querybuf)-pos < (size_t)(c->bulklen+2)) {
             /* Not enough data (+2 == trailing \r\n) */
             break;
         } else {
-            c->argv.emplace_back(c->querybuf + pos, c->bulklen);
+            /* No copy, the argument points into the query buffer. */
+            if (c->argvBufs.empty() || c->argvBufs.back() != c->querybuf)
+                c->argvBufs.push_back(c->querybuf);
+            c->argv.emplace_back(querybuf + pos, c->bulklen);
             pos += c->bulklen+2;
 
             c->bulklen = -1;
@@ -682,15 +916,15 @@ int processMultibulkBuffer(clientBuffer *c) {
         }
     }
 
-    /* Trim to pos */
-    if (pos) sdsrange(c->querybuf,pos,-1);
+    /* Skip what we parsed. The buffer is trimmed when we need room in it. */
+    c->qb_pos = pos;
 
     /* We're done when c->multibulk == 0 */
     if (c->multibulklen == 0) {
-        /* Queue the command in the request queue. */
-        std::lock_guard<std::mutex> lock(requestQMutex);
-        requestQ.emplace(c->fd, c->argv);
+        /* Queue the command in the client's pipeline. */
+        submitCommand(c);
         c->argv.clear();
+        c->argvBufs.clear();
         return C_OK;
     }
 
@@ -699,11 +933,21 @@ int processMultibulkBuffer(clientBuffer *c) {
 }
 
 void processInputBuffer(clientBuffer *c) {
-  /* Keep processing while there is something in the input buffer */
-  while(sdslen(c->querybuf)) {
+  /* Keep processing while there is something in the input buffer, unless
+   * the client has too many requests outstanding. */
+  while(c->qb_pos < sdslen(c->querybuf->buf) && !c->readPaused) {
+    if (admissionEnabled() && admissionAction() == ADMIT_PAUSE &&
+        admissionOverloaded()) {
+      c->readPaused = true;
+      c->overloadPaused = true;
+      c->loop->overloadPausedClients.push_back(c->fd);
+      admissionCountPause();
+      break;
+    }
+
     /* Determine request type when unknown. */
     if (!c->reqtype) {
-      if (c->querybuf[0] == '*') {
+      if (c->querybuf->buf[c->qb_pos] == '*') {
         c->reqtype = PROTO_REQ_MULTIBULK;
       } else {
         c->reqtype = PROTO_REQ_INLINE;
@@ -719,118 +963,931 @@ void processInputBuffer(clientBuffer *c) {
       exit(1);
     }
   }
+
+  scheduleClient(c);
+  /* Requests turned away by admission control are answered already. */
+  addCompletedReplies(c);
+}
+
+/* Queue a response for the reactor of the client the request came from, and
+ * wake the reactor up. */
+/* Wake up a reactor from another thread, unless a wakeup is already on its
+ * way. */
+static void wakeReactor(reactor *loop) {
+  if (!loop->notifyPending.exchange(true)) {
+    uint64_t one = 1;
+    if (write(loop->eventfd, &one, sizeof(one)) == -1) {
+      serverLog(LL_ERROR, "RequestExecutor: eventfd write error: %s",
+          strerror(errno));
+    }
+  }
+}
+
+static void queueResponse(request *req, uint32_t count, std::string &&reply) {
+  reactor *loop = req->loop;
+
+  serverLog(LL_DEBUG, "RequestExecutor: Sending response: %.*s",
+      (int)reply.length(), reply.data());
+
+  /* The reactor never blocks on the request queue, so it always gets
+   * around to draining its response queue. */
+  response r(req->fd, req->clientId, req->seq, count, std::move(reply));
+  if (count != 0) {
+    r.times = req->times;
+    r.times.executedAt = RAMCloud::Cycles::rdtsc();
+    r.slow = std::move(req->slow);
+  }
+  while (!loop->responseQ.tryEnqueue(std::move(r))) {
+    sched_yield();
+  }
+  wakeReactor(loop);
+}
+
+/* Send a reply back through the reactor of the client the request came
+ * from. For a batch, reply holds the replies to all of its requests. */
+void sendResponse(request *req, std::string &&reply) {
+  queueResponse(req, req->batchSize, std::move(reply));
+}
+
+/* Send the first part of a big reply ahead of the rest, so that the reactor
+ * can start writing it while the command is still encoding the rest. */
+void sendPartialResponse(request *req, std::string &&reply) {
+  queueResponse(req, 0, std::move(reply));
+}
+
+/* Drop the keys a write command touched from the near cache. It is done
+ * once the write is over, so that GETs of those keys that are still reading
+ * the old value don't get to cache it. A batch holds the arguments of each of
+ * its requests in turn. */
+static void invalidateCachedKeys(commandContext *c) {
+  redisCommand *cmd = c->req.cmd;
+  std::vector<argView> &argv = c->req.argv;
+  if (c->req.batchSize > 1) {
+    size_t argc = argv.size() / c->req.batchSize;
+    for (size_t i = 0; i < c->req.batchSize; i++)
+      cacheInvalidate(argv[i * argc + cmd->firstkey]);
+    return;
+  }
+
+  std::vector<std::string> keys;
+  getKeysFromCommand(cmd, argv, &keys);
+  for (auto const& key : keys)
+    cacheInvalidate(argView(key.data(), key.size()));
+}
+
+/* Run a command proc, or the continuation of a command whose RPC is ready.
+ * Sends the reply if that finishes the command, and returns false if the
+ * command is waiting on another RPC. */
+bool stepCommand(commandContext *c, commandCont *step) {
+  if (c->waitStart != 0) {
+    latencyAddSampleIfNeeded(LATENCY_RPC,
+        RAMCloud::Cycles::rdtsc() - c->waitStart);
+    c->waitStart = 0;
+  }
+
+  c->rpc = NULL;
+  c->multiOp = NULL;
+  c->pushWait = NULL;
+  c->cont = NULL;
+  try {
+    step(c);
+  } catch (RAMCloud::ClientException& e) {
+    /* Every request of a batch still needs a reply. */
+    c->cancelRpc();
+    c->heldReply.clear();
+    c->reply->buf.clear();
+    for (uint32_t i = 0; i < c->req.batchSize; i++)
+      addReplyErrorFormat(c->reply, "RAMCloud: %s", e.str());
+  }
+
+  if (c->waiting()) {
+    if (latencyMonitorEnabled())
+      c->waitStart = RAMCloud::Cycles::rdtsc();
+    return false;
+  }
+
+  /* Even a write that failed may have gone through. */
+  if ((c->req.cmd->flags & CMD_WRITE) && cacheEnabled())
+    invalidateCachedKeys(c);
+
+  uint64_t execTime = RAMCloud::Cycles::rdtsc() - c->startTime;
+  serverLog(LL_TRACE, "RequestExecutor: Command exec time: %lluus",
+      (unsigned long long)RAMCloud::Cycles::toMicroseconds(execTime));
+  if (c->latency != NULL)
+    admissionRecord(c->latency, execTime);
+  commandStatsRecord(c->stats, c->req.cmd, execTime, c->req.batchSize);
+  latencyAddSampleIfNeeded(LATENCY_COMMAND, execTime);
+  if (slowlogIsSlow(execTime))
+    c->req.slow = slowlogCreate(c->req);
+
+  sendResponse(&c->req, takeReply(c->reply));
+  c->clear();
+  return true;
 }
 
-void requestExecutor(const char* coordLocator) {
+/* Start executing the request in c->req. Returns false if it is waiting on
+ * an RPC. */
+bool startCommand(commandContext *c) {
+  std::vector<argView> &argv = c->req.argv;
+  redisCommand *cmd = c->req.cmd;
+  c->argv = &argv;
+
+  if (VERBOSITY >= LL_DEBUG) {
+    std::string result;
+    for (auto const& s : argv) { result += " " + s.str(); }
+    serverLog(LL_DEBUG, "RequestExecutor: Received command: %s", result.c_str());
+  }
+
+  /* The reactor already looked up the command. */
+  if (cmd == NULL) {
+    std::string name = argv[0].str();
+    serverLog(LL_DEBUG, "RequestExecutor: Unknown command: %s",
+        name.c_str());
+    addReplyErrorFormat(c->reply, "unknown command '%.128s'", name.c_str());
+  } else if (c->req.batchSize == 1 &&
+             ((cmd->arity > 0 && cmd->arity != (int)argv.size()) ||
+              ((int)argv.size() < -cmd->arity))) {
+    /* The reactor only batches requests with the right arity. */
+    serverLog(LL_DEBUG, "RequestExecutor: Wrong number of arguments. "
+        "Expected %d but got %d.", cmd->arity, (int)argv.size());
+    addReplyErrorFormat(c->reply,
+        "wrong number of arguments for '%s' command", cmd->name);
+  } else {
+    c->startTime = RAMCloud::Cycles::rdtsc();
+    return stepCommand(c, cmd->proc);
+  }
+
+  sendResponse(&c->req, takeReply(c->reply));
+  c->clear();
+  return true;
+}
+
+/* Count the time a request spent in its request queue against its lane. */
+static void recordQueueWait(const request &req) {
+  laneStats &lane = lanes[requestLane(req)];
+  uint64_t wait = req.times.dequeuedAt - req.times.queuedAt;
+  lane.requests.fetch_add(1, std::memory_order_relaxed);
+  lane.waitCycles.fetch_add(wait, std::memory_order_relaxed);
+  uint64_t max = lane.maxWaitCycles.load(std::memory_order_relaxed);
+  while (wait > max && !lane.maxWaitCycles.compare_exchange_weak(max, wait,
+        std::memory_order_relaxed)) {}
+}
+
+/* Append the stages section of INFO: how long requests spent in each stage,
+ * over all reactors. */
+void stagesInfo(std::string *info) {
+  static const char *names[NUM_STAGES] =
+      {"dispatch", "queue", "execute", "reply", "total"};
+  info->append("# Stages\r\n");
+  for (int i = 0; i < NUM_STAGES; i++) {
+    histogramSnapshot snapshot;
+    for (auto loop : reactors)
+      snapshot.add(loop->stageTimes[i]);
+
+    char buf[256];
+    snprintf(buf, sizeof(buf),
+        "stage_%s:requests=%llu,usec=%llu,usec_per_request=%.2f,p50=%llu,"
+        "p99=%llu,p99.9=%llu,max=%llu\r\n",
+        names[i], (unsigned long long)snapshot.count,
+        (unsigned long long)snapshot.sum,
+        snapshot.count ? (double)snapshot.sum / snapshot.count : 0.0,
+        (unsigned long long)snapshot.percentile(50.0),
+        (unsigned long long)snapshot.percentile(99.0),
+        (unsigned long long)snapshot.percentile(99.9),
+        (unsigned long long)snapshot.max);
+    info->append(buf);
+  }
+}
+
+/* The number of requests waiting in the request queues, roughly. */
+size_t queuedRequests() {
+  if (fastQ != NULL)
+    return fastQ->sizeGuess() + slowQ->sizeGuess();
+  size_t queued = requestQ->sizeGuess();
+  for (auto q : executorQs)
+    queued += q->sizeGuess();
+  return queued;
+}
+
+/* Append the lanes section of INFO. Queue depths are approximate. */
+void lanesInfo(std::string *info) {
+  static const char *names[NUM_LANES] = {"fast", "slow"};
+  size_t depths[NUM_LANES] = {0, 0};
+  if (fastQ != NULL) {
+    depths[LANE_FAST] = fastQ->sizeGuess();
+    depths[LANE_SLOW] = slowQ->sizeGuess();
+  }
+  size_t queued = queuedRequests();
+
+  char buf[256];
+  snprintf(buf, sizeof(buf),
+      "# Lanes\r\n"
+      "lanes_enabled:%d\r\n"
+      "requests_queued:%zu\r\n",
+      fastQ != NULL ? 1 : 0, queued);
+  info->append(buf);
+
+  for (int i = 0; i < NUM_LANES; i++) {
+    laneStats &lane = lanes[i];
+    uint64_t requests = lane.requests.load(std::memory_order_relaxed);
+    uint64_t wait = RAMCloud::Cycles::toMicroseconds(
+        lane.waitCycles.load(std::memory_order_relaxed));
+    snprintf(buf, sizeof(buf),
+        "lane_%s:queue_depth=%zu,requests=%llu,wait_avg_us=%.2f,"
+        "wait_max_us=%llu\r\n",
+        names[i], depths[i], (unsigned long long)requests,
+        requests ? (double)wait / requests : 0.0,
+        (unsigned long long)RAMCloud::Cycles::toMicroseconds(
+          lane.maxWaitCycles.load(std::memory_order_relaxed)));
+    info->append(buf);
+  }
+}
+
+/* Take a request off the first of queues that has one. If block is set and
+ * they are all empty, sleep on notEmpty, which every one of them signals,
+ * until one isn't. Returns false if there was nothing to take. */
+static bool dequeueRequest(const std::vector<mpmcQueue<request>*> &queues,
+    eventCount *notEmpty, request *req, bool block) {
+  if (queues.size() == 1 && block) {
+    queues[0]->waitDequeue(req);
+    return true;
+  }
+
+  for (int i = 0; ; i++) {
+    for (auto q : queues) {
+      if (q->tryDequeue(req))
+        return true;
+    }
+    if (!block)
+      return false;
+    if (i < QUEUE_SPIN_ITERATIONS) {
+      cpuRelax();
+      continue;
+    }
+
+    uint32_t key = notEmpty->prepareWait();
+    for (auto q : queues) {
+      if (q->tryDequeue(req)) {
+        notEmpty->cancelWait();
+        return true;
+      }
+    }
+    notEmpty->wait(key);
+  }
+}
+
+/* Whether any of the commands in flight waits on a RAMCloud RPC. */
+static bool rpcsOutstanding(const std::vector<commandContext*> &inflight) {
+  for (auto c : inflight) {
+    if (c->rpcOutstanding())
+      return true;
+  }
+  return false;
+}
+
+/* Executor thread. Takes requests off its request queues and executes them,
+ * keeping up to window of them waiting on RAMCloud RPCs at once. It has the
+ * shared queue, its own queue with --key-affinity, or with --fast-threads
+ * the fast lane and, unless it is reserved for fast commands, the slow lane
+ * after it. While any requests are in flight we poll RAMCloud and pick up
+ * new requests without blocking; only an executor with nothing in flight
+ * sleeps on its queues. id numbers the executor from 0.
+ *
+ * RAMCloud transactions commit synchronously, and nothing else in the window
+ * makes progress while one does. So a command flagged CMD_TRANSACTION, or a
+ * push group's commit, waits until no other RPCs are outstanding here, and
+ * no new requests are taken on meanwhile so that the window drains. */
+void requestExecutor(int id, const char* coordLocator, int window,
+    std::vector<mpmcQueue<request>*> queues, eventCount *notEmpty) {
   RAMCloud::RamCloud client(coordLocator);
   uint64_t tableId = client.createTable("default");
+  uint64_t segTableId = client.createTable("default-list-segments");
 
   serverLog(LL_DEBUG, "Request executor thread connected to RAMCloud.");
 
+  /* Replies are encoded here, then handed to the reactor. */
+  replyBuffer reply;
+
+  std::vector<commandContext> contexts(window);
+  std::vector<commandContext*> idle;
+  std::vector<commandContext*> inflight;
+  for (auto& c : contexts) {
+    c.client = &client;
+    c.tableId = tableId;
+    c.segTableId = segTableId;
+    c.reply = &reply;
+    c.latency = admissionEnabled() ? admissionWindow(id) : NULL;
+    c.stats = commandStatsTable(id);
+    idle.push_back(&c);
+  }
+
+  /* A CMD_TRANSACTION request waiting for the window to drain, or NULL. */
+  commandContext *held = NULL;
+  /* Set while a push group's commit waits for the window to drain. */
+  bool draining = false;
+
   while (true) {
-    int cfd;
-    std::vector<std::string> argv;
-    while (true) {
-      if (requestQ.size() == 0)
-        continue;
+    /* Take on new requests while there is room in the window. */
+    while (!idle.empty() && held == NULL && !draining) {
+      commandContext *c = idle.back();
+      /* Sleeps on a futex when there is nothing to do. */
+      if (!dequeueRequest(queues, notEmpty, &c->req, inflight.empty()))
+        break;
+      c->req.times.dequeuedAt = RAMCloud::Cycles::rdtsc();
+      recordQueueWait(c->req);
 
-      std::lock_guard<std::mutex> lock(requestQMutex);
-      if (requestQ.size() > 0) {
-        std::pair<int, std::vector<std::string>> entry = requestQ.front();
-        cfd = entry.first;
-        argv = entry.second;
-        requestQ.pop();
+      idle.pop_back();
+      if (c->req.cmd != NULL && (c->req.cmd->flags & CMD_TRANSACTION) &&
+          rpcsOutstanding(inflight)) {
+        held = c;
         break;
       }
+      if (startCommand(c))
+        idle.push_back(c);
+      else
+        inflight.push_back(c);
     }
 
-    if (VERBOSITY >= LL_DEBUG) {
-      std::string result;
-      for (auto const& s : argv) { result += " " + s; }
-      serverLog(LL_DEBUG, "RequestExecutor: Received command: %s", result.c_str());
+    if (held != NULL && !rpcsOutstanding(inflight)) {
+      if (startCommand(held))
+        idle.push_back(held);
+      else
+        inflight.push_back(held);
+      held = NULL;
     }
 
-    /* Do processing here. */
-    std::string resp;
-    if (redisCommandTable.count(argv[0]) == 0) {
-      serverLog(LL_DEBUG, "RequestExecutor: Unknown command: %s",
-          argv[0].c_str());
+    if (inflight.empty())
+      continue;
 
-      char buf[128];
-      snprintf(buf, sizeof(buf), "+unknown command '%s'\r\n", argv[0].c_str());
-      resp = buf;
-    } else {
-      redisCommand cmd = redisCommandTable[argv[0]];
+    /* Make progress on outstanding RPCs, and continue the commands whose
+     * RPCs are done. */
+    client.poll();
+    draining = false;
+    for (size_t i = 0; i < inflight.size(); ) {
+      commandContext *c = inflight[i];
+      if (!c->rpcReady()) {
+        i++;
+        continue;
+      }
+      if (c->leadsPushGroup() && rpcsOutstanding(inflight)) {
+        draining = true;
+        i++;
+        continue;
+      }
+      if (!stepCommand(c, c->cont)) {
+        i++;
+        continue;
+      }
+      inflight[i] = inflight.back();
+      inflight.pop_back();
+      idle.push_back(c);
+    }
+  }
+}
 
-      if ((cmd.arity > 0 && cmd.arity != argv.size()) ||
-               ((int)argv.size() < -cmd.arity)) {
-        serverLog(LL_DEBUG, "RequestExecutor: Wrong number of arguments. "
-            "Expected %d but got %d.", cmd.arity, argv.size());
+/* Close a client connection and release its resources. The connection table
+ * is indexed by file descriptor. Closing the descriptor also removes it from
+ * the epoll interest list. */
+void freeClient(clientBuffer *c) {
+  c->loop->clients[c->fd] = NULL;
+  close(c->fd);
+  delete c;
+}
+
+/* Schedule a client to be freed at the end of the current event loop
+ * iteration. Used where the caller may still be holding on to the client. */
+void freeClientAsync(clientBuffer *c) {
+  if (c->closeAsap)
+    return;
+  c->closeAsap = true;
+  c->loop->clientsToClose.push_back(c->fd);
+}
+
+/* Free the clients scheduled with freeClientAsync(). */
+void freeClientsInAsyncFreeQueue(reactor *loop) {
+  for (int fd : loop->clientsToClose) {
+    clientBuffer *c = loop->clients[fd];
+    if (c != NULL && c->closeAsap)
+      freeClient(c);
+  }
+  loop->clientsToClose.clear();
+}
+
+/* Accept all pending connections on the reactor's listening socket. The
+ * socket is edge triggered, so keep going until accept() would block. Returns
+ * C_ERR on a fatal accept error. */
+int acceptTcpHandler(reactor *loop) {
+  while (true) {
+    struct sockaddr_storage sa;
+    socklen_t salen = sizeof(sa);
+
+    int cfd = accept4(loop->sfd, (struct sockaddr*)&sa, &salen,
+        SOCK_NONBLOCK);
+
+    if (cfd == -1) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        return C_OK;
+      } else if (errno == EINTR || errno == ECONNABORTED) {
+        continue;
+      } else if (errno == EMFILE || errno == ENFILE) {
+        /* Out of descriptors. Leave the connection in the backlog, we'll
+         * get another event when the next one comes in. */
+        serverLog(LL_WARN, "Accept error: %s", strerror(errno));
+        return C_OK;
+      }
+
+      serverLog(LL_ERROR, "Accept error: %s", strerror(errno));
+      return C_ERR;
+    }
+
+    struct sockaddr_in *s = (struct sockaddr_in*)&sa;
+    int port = ntohs(s->sin_port);
+    char ip[NET_IP_STR_LEN];
+    inet_ntop(AF_INET, (void*)&(s->sin_addr), ip, sizeof(ip));
+
+    serverLog(LL_INFO, "Received client connection on reactor %d: %s:%d",
+        loop->id, ip, port);
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+    ev.data.fd = cfd;
+    if (epoll_ctl(loop->epfd, EPOLL_CTL_ADD, cfd, &ev) == -1) {
+      serverLog(LL_ERROR, "epoll_ctl(ADD): %s. Closing client.",
+          strerror(errno));
+      close(cfd);
+      continue;
+    }
 
-        char buf[128];
-        snprintf(buf, sizeof(buf), "+wrong number of arguments for '%s' command. Expected %d got %d.\r\n", argv[0].c_str(), cmd.arity, argv.size());
-        resp = buf;
+    if (cfd >= (int)loop->clients.size()) {
+      loop->clients.resize(cfd + 1, NULL);
+    }
+    clientBuffer *c = new clientBuffer(cfd, loop);
+    c->addr = std::string(ip) + ":" + std::to_string(port);
+    loop->clients[cfd] = c;
+  }
+}
+
+/* Read everything available on a client socket, parsing complete requests as
+ * we go. The socket is edge triggered, so we must read until EAGAIN, unless
+ * the client gets paused, in which case resumeClient() picks up from here. */
+void readQueryFromClient(clientBuffer *c) {
+  while (!c->closeAsap && !c->readPaused) {
+    size_t readlen = PROTO_IOBUF_LEN;
+    size_t unparsed = sdslen(c->querybuf->buf) - c->qb_pos;
+
+    /* A big argument has a buffer of its own. Read the rest of it in one go,
+     * and nothing past it. */
+    if (c->multibulklen && c->bulklen >= PROTO_MBULK_BIG_ARG &&
+        unparsed < (size_t)c->bulklen + 2) {
+      readlen = c->bulklen + 2 - unparsed;
+    }
+
+    if (sdsavail(c->querybuf->buf) < readlen)
+      resizeQueryBuffer(c, unparsed + readlen);
+
+    sds querybuf = c->querybuf->buf;
+    size_t qblen = sdslen(querybuf);
+    int nbytes = read(c->fd, querybuf + qblen, readlen);
+    if (nbytes == -1) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        /* That's fine, we've drained the socket. */
+        return;
+      } else if (errno == EINTR) {
+        continue;
       } else {
-        uint64_t start = RAMCloud::Cycles::rdtsc();
-        resp = cmd.proc(&client, tableId, &argv);
-        uint64_t end = RAMCloud::Cycles::rdtsc();
-        serverLog(LL_TRACE, "RequestExecutor: Command exec time: %dus", 
-            RAMCloud::Cycles::toMicroseconds(end - start));
+        /* Got an error. Close the client. */
+        serverLog(LL_ERROR, "Read error: %s. Closing client.", 
+            strerror(errno));
+        freeClient(c);
+        return;
       }
+    } else if (nbytes == 0) {
+      /* Client closed connection. */
+      serverLog(LL_INFO, "Client connection closed.");
+      freeClient(c);
+      return;
+    } else {
+      /* Houston, we have data! */
+      sdsIncrLen(querybuf, nbytes);
+      processInputBuffer(c);
     }
+  }
+}
+
+/* Start parsing a paused client's input again, once it no longer has ready
+ * requests waiting for room in the request queue, and is back under the
+ * pipeline limit and the output buffer soft limit. Anything already buffered
+ * is parsed first. The socket is
+ * edge triggered, so we then have to read it until EAGAIN ourselves. */
+void resumeClient(clientBuffer *c) {
+  if (!c->readPaused || c->closeAsap || c->overloadPaused ||
+      !c->readyQ.empty() ||
+      c->pipeline.size() >= PIPELINE_MAX_PENDING ||
+      (outputBufferSoftLimit && c->replyBytes > outputBufferSoftLimit))
+    return;
+  c->readPaused = false;
+  processInputBuffer(c);
+  if (!c->readPaused)
+    readQueryFromClient(c);
+}
 
-    serverLog(LL_DEBUG, "RequestExecutor: Sending response: %s", resp.c_str());
+/* Dispatch the ready requests of the clients on the reactor's list by
+ * deficit round robin. Every round, each client on the list gets
+ * CLIENT_QUANTUM more requests' worth of deficit to dispatch with, so a
+ * client with thousands of requests pipelined gets no more of the request
+ * queue than one with a few. Clients leave the list once they have nothing
+ * left to dispatch or hit the in-flight limit, and lose what deficit they had
+ * left. If the request queue fills up, the client at the front keeps its
+ * place and we try again on the next event loop iteration. */
+void dispatchReadyClients(reactor *loop) {
+  while (!loop->readyClients.empty()) {
+    int fd = loop->readyClients.front();
+    loop->readyClients.pop_front();
+    clientBuffer *c = loop->clients[fd];
+    if (c == NULL || !c->inReadyClients)
+      continue;
 
-    {
-      std::lock_guard<std::mutex> lock(responseQMutex);
-      responseQ.emplace(cfd, resp.c_str());
+    c->deficit += CLIENT_QUANTUM;
+    int status = dispatchReadyRequests(c);
+    if (status == DISPATCH_FULL) {
+      loop->readyClients.push_front(fd);
+      return;
+    } else if (status == DISPATCH_DEFICIT) {
+      loop->readyClients.push_back(fd);
+      continue;
     }
+
+    c->inReadyClients = false;
+    c->deficit = 0;
+    resumeClient(c);
   }
 }
 
-static const char USAGE[] =
-R"(Ramdis Server.
+/* Start reading from the clients paused for overload again, once the server
+ * is no longer overloaded. */
+void resumeOverloadPausedClients(reactor *loop) {
+  if (loop->overloadPausedClients.empty() || admissionOverloaded())
+    return;
+
+  std::vector<int> paused;
+  paused.swap(loop->overloadPausedClients);
+  for (int fd : paused) {
+    clientBuffer *c = loop->clients[fd];
+    if (c == NULL || !c->overloadPaused)
+      continue;
+    c->overloadPaused = false;
+    resumeClient(c);
+  }
+}
 
-    Usage:
-      ramdis-server [options] RAMCLOUDCOORDLOC
+/* Take a snapshot of the reactor's clients for CLIENT LIST, if an executor
+ * asked for one since the last. Nothing is done for CLIENT LIST otherwise,
+ * so a reactor pays for it only when it is used. */
+void takeClientList(reactor *loop) {
+  uint64_t wanted = loop->clientListWanted.load(std::memory_order_acquire);
+  if (wanted == loop->clientListTakenFor)
+    return;
+
+  std::vector<clientInfo> list;
+  for (auto c : loop->clients) {
+    if (c == NULL)
+      continue;
+    clientInfo info;
+    info.id = c->id;
+    info.addr = c->addr;
+    info.fd = c->fd;
+    info.ctime = c->ctime;
+    info.qbuf = sdslen(c->querybuf->buf) - c->qb_pos;
+    info.pipeline = c->pipeline.size();
+    info.ready = c->readyQ.size();
+    info.inflight = c->inflight;
+    info.deficit = c->deficit;
+    info.omem = c->replyBytes;
+    list.push_back(std::move(info));
+  }
+  {
+    std::lock_guard<std::mutex> guard(loop->clientListLock);
+    loop->clientListSnapshot.swap(list);
+    loop->clientListTakenFor = wanted;
+  }
+  loop->clientListTaken.notify_all();
+}
 
-    Arguments:
-      RAMCLOUDCOORDLOC  RAMCloud coordinator locator string.
+/* CLIENT LIST, run by an executor: ask every reactor for a snapshot of its
+ * clients, and wait for them to take it on their next event loop iteration.
+ * A reactor that takes longer than CLIENT_LIST_WAIT_MS is shown as of its
+ * last snapshot. */
+void clientList(std::string *list) {
+  std::vector<uint64_t> wanted;
+  for (auto loop : reactors) {
+    wanted.push_back(loop->clientListWanted.fetch_add(1,
+          std::memory_order_release) + 1);
+    wakeReactor(loop);
+  }
 
-    Options:
-      --host=HOST  Host IPv4 address to use [default: 127.0.0.1] 
-      --port=PORT  Port number to use [default: 6379]
-      --threads=N  Number of request executor threads to run in parallel
-      [default: 1]
+  time_t now = time(NULL);
+  for (size_t i = 0; i < reactors.size(); i++) {
+    reactor *loop = reactors[i];
+    std::unique_lock<std::mutex> guard(loop->clientListLock);
+    loop->clientListTaken.wait_for(guard,
+        std::chrono::milliseconds(CLIENT_LIST_WAIT_MS),
+        [&] { return loop->clientListTakenFor >= wanted[i]; });
+    for (auto const& c : loop->clientListSnapshot) {
+      char buf[512];
+      snprintf(buf, sizeof(buf),
+          "id=%llu addr=%s fd=%d age=%ld io=%d qbuf=%zu pipeline=%zu "
+          "ready=%zu inflight=%u deficit=%u omem=%zu\n",
+          (unsigned long long)c.id, c.addr.c_str(), c.fd,
+          (long)(now - c.ctime), loop->id, c.qbuf, c.pipeline, c.ready,
+          c.inflight, c.deficit, c.omem);
+      list->append(buf);
+    }
+  }
+}
 
-)";
+void slowlogEntries(
+    std::vector<std::shared_ptr<const slowlogEntry>> *entries) {
+  for (auto loop : reactors) {
+    std::lock_guard<std::mutex> guard(loop->slowlog.lock);
+    entries->insert(entries->end(), loop->slowlog.entries.begin(),
+        loop->slowlog.entries.end());
+  }
+  std::sort(entries->begin(), entries->end(),
+      [](const std::shared_ptr<const slowlogEntry> &a,
+        const std::shared_ptr<const slowlogEntry> &b) {
+      return a->id > b->id;
+    });
+}
 
-int main(int argc, char *argv[]) {
+size_t slowlogLength() {
+  size_t len = 0;
+  for (auto loop : reactors) {
+    std::lock_guard<std::mutex> guard(loop->slowlog.lock);
+    len += loop->slowlog.entries.size();
+  }
+  return len;
+}
 
-  /* Parse command line options. */
+/* The entries are freed after the lock is let go. */
+void slowlogReset() {
+  for (auto loop : reactors) {
+    std::deque<std::shared_ptr<const slowlogEntry>> dropped;
+    std::lock_guard<std::mutex> guard(loop->slowlog.lock);
+    dropped.swap(loop->slowlog.entries);
+  }
+}
 
-  std::map<std::string, docopt::value> args = docopt::docopt(USAGE, 
-      {argv + 1, argv + argc},
-      true,               // show help if requested
-      "Ramdis Server 0.0");      // version string
+/* Start or stop watching a client socket for writability. */
+int setWriteHandler(clientBuffer *c, bool install) {
+  if (c->writeHandlerInstalled == install)
+    return C_OK;
+
+  struct epoll_event ev;
+  ev.events = EPOLLIN | EPOLLRDHUP | EPOLLET | (install ? (uint32_t)EPOLLOUT : 0);
+  ev.data.fd = c->fd;
+  if (epoll_ctl(c->loop->epfd, EPOLL_CTL_MOD, c->fd, &ev) == -1) {
+    serverLog(LL_ERROR, "epoll_ctl(MOD): %s. Closing client.",
+        strerror(errno));
+    freeClientAsync(c);
+    return C_ERR;
+  }
+  c->writeHandlerInstalled = install;
+  return C_OK;
+}
 
-  for (auto const& arg : args) {
-    std::cout << arg.first << ": " << arg.second << std::endl;
+/* Append a reply to the client's output buffer. The buffer is written out
+ * before the reactor goes back to sleep, so replies that come in during the
+ * same event loop iteration go out in a single writev(). A client that lets
+ * its output buffer grow past the soft limit stops having its input parsed
+ * until it catches up, and one that goes past the hard limit is
+ * disconnected. */
+void addReply(clientBuffer *c, std::string &&reply) {
+  if (c->closeAsap)
+    return;
+
+  c->replyBytes += reply.length();
+  c->replyOffset += reply.length();
+  c->reply.push_back(std::move(reply));
+
+  if (!c->pendingWrite && !c->writeHandlerInstalled) {
+    c->pendingWrite = true;
+    c->loop->clientsPendingWrite.push_back(c->fd);
   }
 
-  serverLog(LL_INFO, "Server verbosity set to %d", VERBOSITY);
+  if (outputBufferHardLimit && c->replyBytes > outputBufferHardLimit) {
+    serverLog(LL_WARN, "Client output buffer of %lu bytes is over the hard "
+        "limit. Closing client.", c->replyBytes);
+    freeClientAsync(c);
+  } else if (outputBufferSoftLimit && c->replyBytes > outputBufferSoftLimit) {
+    c->readPaused = true;
+  }
+}
+
+/* Cycles from one stage stamp to a later one. Stamps taken on different
+ * cores may be a little out of step. */
+static inline uint64_t stageCycles(uint64_t from, uint64_t to) {
+  return to > from ? to - from : 0;
+}
+
+/* Record the stage times of the requests whose replies are now written out
+ * in full. */
+static void timeWrittenReplies(clientBuffer *c) {
+  reactor *loop = c->loop;
+  uint64_t now = 0;
+  while (!c->replyMarks.empty() && c->replyMarks.front().end <= c->sentOffset) {
+    if (now == 0)
+      now = RAMCloud::Cycles::rdtsc();
+    replyMark &mark = c->replyMarks.front();
+    const requestTimes &t = mark.times;
+    uint64_t stages[NUM_STAGES];
+    stages[STAGE_DISPATCH] = stageCycles(t.parsedAt, t.queuedAt);
+    stages[STAGE_QUEUE] = stageCycles(t.queuedAt, t.dequeuedAt);
+    stages[STAGE_EXECUTE] = stageCycles(t.dequeuedAt, t.executedAt);
+    stages[STAGE_REPLY] = stageCycles(t.executedAt, now);
+    stages[STAGE_TOTAL] = stageCycles(t.parsedAt, now);
+    for (int i = 0; i < NUM_STAGES; i++) {
+      loop->stageTimes[i].record(
+          RAMCloud::Cycles::toMicroseconds(stages[i]));
+    }
+
+    if (traceSample != 0 && ++loop->timedRequests % traceSample == 0) {
+      PerfUtils::TimeTrace::record(now, "Reply written: dispatch %u ns, "
+          "queue %u ns, execute %u ns, reply %u ns",
+          (uint32_t)RAMCloud::Cycles::toNanoseconds(stages[STAGE_DISPATCH]),
+          (uint32_t)RAMCloud::Cycles::toNanoseconds(stages[STAGE_QUEUE]),
+          (uint32_t)RAMCloud::Cycles::toNanoseconds(stages[STAGE_EXECUTE]),
+          (uint32_t)RAMCloud::Cycles::toNanoseconds(stages[STAGE_REPLY]));
+    }
+
+    if (mark.slow) {
+      mark.slow->addr = c->addr;
+      for (int i = 0; i < NUM_STAGES; i++)
+        mark.slow->stages[i] = RAMCloud::Cycles::toMicroseconds(stages[i]);
+      slowlogPush(&loop->slowlog, std::move(mark.slow));
+    }
+    c->replyMarks.pop_front();
+  }
+}
+
+/* Move the client's replies that are next in line to its output buffer, in
+ * request order. Stops at the first request that is still executing, after
+ * moving whatever part of its reply has come in so far. */
+void addCompletedReplies(clientBuffer *c) {
+  while (!c->pipeline.empty() && c->pipeline.front().state == PIPELINE_DONE) {
+    pipelineEntry &e = c->pipeline.front();
+    if (!e.reply.empty())
+      addReply(c, std::move(e.reply));
+    /* Requests turned away by admission control were never timed. */
+    if (e.times.executedAt != 0)
+      c->replyMarks.emplace_back(c->replyOffset, e.times, std::move(e.slow));
+    c->pipeline.pop_front();
+    c->pipelineBase++;
+  }
+  if (!c->pipeline.empty() && !c->pipeline.front().reply.empty()) {
+    addReply(c, std::move(c->pipeline.front().reply));
+    c->pipeline.front().reply.clear();
+  }
+  /* Nothing may be left to write for the last of them, as for the later
+   * requests of a batch. */
+  if (c->replyBytes == 0)
+    timeWrittenReplies(c);
+}
+
+/* Write as much of the client's output buffer as the socket takes, several
+ * replies per writev(). If the socket fills up, watch it for EPOLLOUT and
+ * continue from there, rather than waiting for it here. */
+void writeToClient(clientBuffer *c) {
+  struct iovec iov[NET_MAX_WRITEV_IOV];
+  uint64_t start = RAMCloud::Cycles::rdtsc();
+
+  while (c->replyBytes > 0) {
+    int iovcnt = 0;
+    size_t offset = c->sentlen;
+    for (auto it = c->reply.begin();
+        it != c->reply.end() && iovcnt < NET_MAX_WRITEV_IOV; ++it) {
+      iov[iovcnt].iov_base = (void*)(it->data() + offset);
+      iov[iovcnt].iov_len = it->length() - offset;
+      iovcnt++;
+      offset = 0;
+    }
+
+    ssize_t nwritten = writev(c->fd, iov, iovcnt);
+    if (nwritten == -1) {
+      if (errno == EINTR) {
+        continue;
+      } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        setWriteHandler(c, true);
+        latencyAddSampleIfNeeded(LATENCY_FLUSH,
+            RAMCloud::Cycles::rdtsc() - start);
+        return;
+      } else {
+        serverLog(LL_ERROR, "Write error: %s. Closing client.",
+            strerror(errno));
+        freeClientAsync(c);
+        return;
+      }
+    }
+
+    /* Drop what was written from the front of the buffer. */
+    c->replyBytes -= nwritten;
+    c->sentOffset += nwritten;
+    timeWrittenReplies(c);
+    while (nwritten > 0) {
+      size_t left = c->reply.front().length() - c->sentlen;
+      if ((size_t)nwritten < left) {
+        c->sentlen += nwritten;
+        break;
+      }
+      nwritten -= left;
+      c->reply.pop_front();
+      c->sentlen = 0;
+    }
+  }
+
+  setWriteHandler(c, false);
+}
+
+/* Flush the output buffers of the clients that got replies during this event
+ * loop iteration. */
+void handleClientsWithPendingWrites(reactor *loop) {
+  /* Writing may resume a throttled client, which may queue more writes. */
+  std::vector<int> pending;
+  pending.swap(loop->clientsPendingWrite);
+
+  for (int fd : pending) {
+    clientBuffer *c = loop->clients[fd];
+    if (c == NULL || !c->pendingWrite)
+      continue;
+    c->pendingWrite = false;
+    if (c->closeAsap)
+      continue;
+    writeToClient(c);
+    resumeClient(c);
+  }
+}
+
+/* Add part of the reply to a request that is still executing. If the
+ * request is next in line it goes straight to the output buffer. */
+void addPartialReply(clientBuffer *c, uint64_t seq, std::string &&reply) {
+  pipelineEntry &e = c->pipeline[seq - c->pipelineBase];
+  if (seq != c->pipelineBase) {
+    e.reply.append(reply);
+    return;
+  }
+  if (!e.reply.empty()) {
+    addReply(c, std::move(e.reply));
+    e.reply.clear();
+  }
+  addReply(c, std::move(reply));
+}
+
+/* Hand the responses executors have queued for this reactor's clients back to
+ * their pipelines, and buffer every reply that is next in line. */
+void sendResponses(reactor *loop) {
+  response r;
+  while (loop->responseQ.tryDequeue(&r)) {
+    int cfd = r.fd;
+    if (cfd >= (int)loop->clients.size())
+      continue;
+
+    /* Skip responses for a client that we already closed the connection for,
+     * even if its descriptor has been reused since. */
+    clientBuffer *c = loop->clients[cfd];
+    if (c == NULL || c->id != r.clientId || c->closeAsap)
+      continue;
+
+    if (r.count == 0) {
+      addPartialReply(c, r.seq, std::move(r.reply));
+      continue;
+    }
 
-  /* Open a listening socket for the server. */
+    /* A batch's replies all go out with its first request. */
+    completeRequest(c, r.seq, std::move(r.reply));
+    for (uint32_t i = 1; i < r.count; i++)
+      completeRequest(c, r.seq + i, std::string());
+    for (uint32_t i = 0; i < r.count; i++)
+      c->pipeline[r.seq + i - c->pipelineBase].times = r.times;
+    c->pipeline[r.seq - c->pipelineBase].slow = std::move(r.slow);
+    c->inflight -= r.count;
+    scheduleClient(c);
+    addCompletedReplies(c);
+  }
+}
 
+/* Open a non-blocking listening socket on the given port. SO_REUSEPORT is set
+ * so that every reactor can bind its own socket to the same port and let the
+ * kernel spread incoming connections across them. Returns the socket, or -1
+ * on error. */
+int listenToPort(const char *host, const char *port) {
   struct addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
   hints.ai_family = AF_INET;
   hints.ai_socktype = SOCK_STREAM;
   hints.ai_protocol = IPPROTO_TCP;
   hints.ai_flags = AI_PASSIVE | AI_NUMERICSERV;
 
   struct addrinfo *servinfo = NULL;
-  int rv = getaddrinfo(NULL, args["--port"].asString().c_str(), &hints, 
-      &servinfo);
+  int rv = getaddrinfo(NULL, port, &hints, &servinfo);
 
   if (rv != 0) {
     serverLog(LL_ERROR, "%s", gai_strerror(rv));
@@ -851,6 +1908,13 @@ int main(int argc, char *argv[]) {
       return -1;
     }
 
+    if (setsockopt(sfd, SOL_SOCKET, SO_REUSEPORT, &yes, sizeof(yes)) == -1) {
+      serverLog(LL_ERROR, "setsockopt SO_REUSEPORT: %s", strerror(errno));
+      close(sfd);
+      freeaddrinfo(servinfo);
+      return -1;
+    }
+
     if (bind(sfd, p->ai_addr, p->ai_addrlen) == -1) {
       serverLog(LL_ERROR, "Bind error: %s", strerror(errno));
       close(sfd);
@@ -865,10 +1929,6 @@ int main(int argc, char *argv[]) {
       return -1;
     }
 
-    serverLog(LL_INFO, "Listening on %s:%s", 
-        args["--host"].asString().c_str(), 
-        args["--port"].asString().c_str());
-
     break;
   }
 
@@ -880,8 +1940,8 @@ int main(int argc, char *argv[]) {
 
   freeaddrinfo(servinfo);
 
-  /* Set the listening socket to non-blocking. This is so that calls to
-   * accept() will return immediately if there are no new connections. */
+  /* Set the listening socket to non-blocking. The event loop is edge
+   * triggered, so accept() is called until it would block. */
 
   int flags;
   if ((flags = fcntl(sfd, F_GETFL)) == -1) {
@@ -898,155 +1958,337 @@ int main(int argc, char *argv[]) {
     return -1;
   }
 
-  /* Start request executor threads. */
-  std::vector<std::thread> threads;
-  for (int i = 0; i < (int)args["--threads"].asLong(); i++) {
-    threads.emplace_back(requestExecutor,
-        args["RAMCLOUDCOORDLOC"].asString().c_str());
+  serverLog(LL_INFO, "Listening on %s:%s", host, port);
+
+  return sfd;
+}
+
+/* Set up a reactor: its own listening socket, the eventfd executors use to
+ * tell it about new responses, and an epoll instance watching both. */
+int initReactor(reactor *loop, const char *host, const char *port) {
+  loop->sfd = listenToPort(host, port);
+  if (loop->sfd == -1)
+    return C_ERR;
+
+  loop->eventfd = eventfd(0, EFD_NONBLOCK);
+  if (loop->eventfd == -1) {
+    serverLog(LL_ERROR, "eventfd: %s", strerror(errno));
+    close(loop->sfd);
+    return C_ERR;
   }
 
-  /* In a loop:
-   * 1) accept new client connections
-   * 2) read new data on client connections and buffer it
-   * 3) parse client data buffers for new requests
-   * 4) enqueue new requests on request queue
-   * 5) check response queue for new responses
-   * 6) send responses to clients
-   */
+  loop->epfd = epoll_create1(0);
+  if (loop->epfd == -1) {
+    serverLog(LL_ERROR, "epoll_create1: %s", strerror(errno));
+    close(loop->eventfd);
+    close(loop->sfd);
+    return C_ERR;
+  }
 
-  // Client file descriptor -> buffer of data read from socket
-  std::map<int, clientBuffer> clientBuffers;
+  struct epoll_event ev;
+  ev.events = EPOLLIN | EPOLLET;
+  ev.data.fd = loop->sfd;
+  if (epoll_ctl(loop->epfd, EPOLL_CTL_ADD, loop->sfd, &ev) == -1) {
+    serverLog(LL_ERROR, "epoll_ctl(ADD): %s", strerror(errno));
+    close(loop->epfd);
+    close(loop->eventfd);
+    close(loop->sfd);
+    return C_ERR;
+  }
+
+  ev.events = EPOLLIN | EPOLLET;
+  ev.data.fd = loop->eventfd;
+  if (epoll_ctl(loop->epfd, EPOLL_CTL_ADD, loop->eventfd, &ev) == -1) {
+    serverLog(LL_ERROR, "epoll_ctl(ADD): %s", strerror(errno));
+    close(loop->epfd);
+    close(loop->eventfd);
+    close(loop->sfd);
+    return C_ERR;
+  }
+
+  return C_OK;
+}
 
-  fd_set cfds, _cfds;
-  FD_ZERO(&cfds);
+/* Run a reactor's event loop. In a loop:
+ * 1) wait for events on the listening socket, client sockets and the
+ *    response eventfd
+ * 2) accept new client connections
+ * 3) read new data on readable client connections and buffer it
+ * 4) parse client data buffers for new requests and enqueue them on the
+ *    request queue, holding back requests on keys that an earlier request
+ *    from the same client is still working on
+ * 5) check the reactor's response queue for new responses and buffer them
+ *    for their clients in request order
+ * 6) retry enqueueing requests that found the request queue full
+ * 7) write out client output buffers, continuing on EPOLLOUT if a socket
+ *    fills up
+ * Only returns on a fatal error. */
+int runReactor(reactor *loop) {
+  struct epoll_event events[MAX_EPOLL_EVENTS];
 
   while(true) {
-    int cfd;
-    struct sockaddr_storage sa;
-    socklen_t salen = sizeof(sa);
-    
-    cfd = accept(sfd, (struct sockaddr*)&sa, &salen);
-    
-    if (cfd == -1) {
-      if (errno != EAGAIN && errno != EWOULDBLOCK) {
-        serverLog(LL_ERROR, "Accept error: %s", strerror(errno));
-        for (auto const& entry : clientBuffers) { 
-          close(entry.first);
+    /* Executors don't tell us when the request queue has room again, so
+     * poll while clients are waiting for it. */
+    int timeout = loop->readyClients.empty() ? -1 : 1;
+    if (timeout == -1 && !loop->overloadPausedClients.empty())
+      timeout = ADMIT_CHECK_MS;
+    /* Resuming a client may have answered requests admission control turned
+     * away, after the writes were done. */
+    if (!loop->clientsPendingWrite.empty())
+      timeout = 0;
+    int nevents = epoll_wait(loop->epfd, events, MAX_EPOLL_EVENTS, timeout);
+    uint64_t iterationStart = RAMCloud::Cycles::rdtsc();
+
+    if (nevents == -1) {
+      if (errno == EINTR)
+        continue;
+
+      serverLog(LL_ERROR, "epoll_wait error: %s", strerror(errno));
+      break;
+    }
+
+    for (int i = 0; i < nevents; i++) {
+      int fd = events[i].data.fd;
+
+      if (fd == loop->sfd) {
+        if (acceptTcpHandler(loop) == C_ERR)
+          goto err;
+      } else if (fd == loop->eventfd) {
+        uint64_t count;
+        if (read(loop->eventfd, &count, sizeof(count)) == -1 &&
+            errno != EAGAIN) {
+          serverLog(LL_ERROR, "eventfd read error: %s", strerror(errno));
+        }
+        /* Clear before draining responseQ so that responses enqueued from
+         * here on generate a new wakeup. */
+        loop->notifyPending.store(false);
+      } else if (fd < (int)loop->clients.size() && 
+          loop->clients[fd] != NULL) {
+        clientBuffer *c = loop->clients[fd];
+        uint32_t mask = events[i].events;
+        if (mask & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+          readQueryFromClient(c);
+        /* Reading may have closed the client. */
+        if ((mask & EPOLLOUT) && loop->clients[fd] == c && !c->closeAsap) {
+          writeToClient(c);
+          resumeClient(c);
         }
-        close(sfd);
-        return -1;
       }
-    } else {
-      struct sockaddr_in *s = (struct sockaddr_in*)&sa;
-      int port = ntohs(s->sin_port);
-      char ip[NET_IP_STR_LEN];
-      inet_ntop(AF_INET, (void*)&(s->sin_addr), ip, sizeof(ip));
-     
-      serverLog(LL_INFO, "Received client connection: %s:%d", ip, port);
-
-      clientBuffers.emplace(cfd, cfd);
-      FD_SET(cfd, &cfds);
     }
 
-    memcpy(&_cfds, &cfds, sizeof(fd_set));
+    sendResponses(loop);
+    resumeOverloadPausedClients(loop);
+    handleClientsWithPendingWrites(loop);
+    /* Last, so that requests parsed by clients resumed above go out now,
+     * rather than after the next epoll_wait(). */
+    dispatchReadyClients(loop);
+    freeClientsInAsyncFreeQueue(loop);
+    takeClientList(loop);
+    latencyAddSampleIfNeeded(LATENCY_EVENT_LOOP,
+        RAMCloud::Cycles::rdtsc() - iterationStart);
+  }
+
+err:
+  for (auto c : loop->clients) {
+    if (c) freeClient(c);
+  }
+  close(loop->sfd);
+  return C_ERR;
+}
 
-    struct timeval tv;
-    tv.tv_sec = 0;
-    tv.tv_usec = 0;
-    int retval = select(FD_SETSIZE, &_cfds, NULL, NULL, &tv);
+/* Entry point of the extra I/O threads. A reactor only returns on a fatal
+ * error, in which case the whole server goes down, as it would if the main
+ * thread's reactor failed. */
+void reactorThread(reactor *loop) {
+  runReactor(loop);
+  exit(1);
+}
 
-    if (retval < 0) {
-      serverLog(LL_ERROR, "Select error: %s", strerror(errno));
-      for (auto const& entry : clientBuffers) { 
-        close(entry.first);
-      }
-      close(sfd);
+/* The unit tests in tests/ link in the rest of this file. */
+#ifndef RAMDIS_SERVER_TEST
+
+static const char USAGE[] =
+R"(Ramdis Server.
+
+    Usage:
+      ramdis-server [options] RAMCLOUDCOORDLOC
+
+    Arguments:
+      RAMCLOUDCOORDLOC  RAMCloud coordinator locator string.
+
+    Options:
+      --host=HOST  Host IPv4 address to use [default: 127.0.0.1] 
+      --port=PORT  Port number to use [default: 6379]
+      --threads=N  Number of request executor threads to run in parallel
+      [default: 1]
+      --io-threads=N  Number of I/O threads, each accepting, parsing and
+      replying on its own listening socket [default: 1]
+      --queue-size=N  Capacity of the request queue and of each I/O thread's
+      response queue [default: 65536]
+      --rpc-window=N  Max number of commands each executor thread keeps
+      waiting on RAMCloud at once [default: 16]
+      --client-max-inflight=N  Max requests of one client in the request
+      queue or executing at once, 0 for no limit [default: 256]
+      --output-buffer-soft-limit=BYTES  Stop reading requests from a client
+      while this many reply bytes are waiting to be written to it, 0 for no
+      limit [default: 1048576]
+      --output-buffer-hard-limit=BYTES  Disconnect a client once this many
+      reply bytes are waiting to be written to it, 0 for no limit
+      [default: 67108864]
+      --fast-threads=N  Queue commands flagged as fast apart from the rest,
+      ahead of them, and reserve this many executor threads for them, 0 for a
+      single queue [default: 0]
+      --key-affinity  Give each executor thread a request queue of its own,
+      and send requests to the one their first key hashes to, so requests on
+      the same key run on the same thread
+      --cache-size=BYTES  Size of the near cache of GET replies shared by
+      the executor threads, 0 to disable it [default: 0]
+      --cache-ttl=MS  Revalidate cached replies against RAMCloud once they are
+      this old, so that writes through other servers are seen, 0 to only drop
+      them on writes through this one [default: 0]
+      --admit-max-queued=N  Treat the server as overloaded while more than
+      this many requests wait in the request queues, 0 for no limit
+      [default: 0]
+      --admit-max-p99-us=US  Treat the server as overloaded while the p99
+      command execution time over the last second is above this, 0 for no
+      limit [default: 0]
+      --admit-action=ACTION  What to do with new requests while overloaded:
+      busy to answer them with -BUSY, pause to stop reading from clients
+      [default: busy]
+      --trace-sample=N  Record the stage times of every Nth request in the
+      PerfUtils time trace, which DEBUG TIMETRACE returns, 0 for none
+      [default: 0]
+      --slowlog-log-slower-than=US  Put commands that take longer than this
+      to execute in the slow log, 0 for all of them, negative for none
+      [default: 10000]
+      --slowlog-max-len=N  Max entries kept in the slow log of each I/O thread
+      [default: 128]
+      --latency-monitor-threshold=MS  Sample event loop iterations, commands,
+      waits on RAMCloud and output buffer writes that take at least this long
+      for LATENCY, 0 to turn the monitor off [default: 0]
+
+)";
+
+int main(int argc, char *argv[]) {
+
+  /* Parse command line options. */
+
+  std::map<std::string, docopt::value> args = docopt::docopt(USAGE, 
+      {argv + 1, argv + argc},
+      true,               // show help if requested
+      "Ramdis Server 0.0");      // version string
+
+  for (auto const& arg : args) {
+    std::cout << arg.first << ": " << arg.second << std::endl;
+  }
+
+  serverLog(LL_INFO, "Server verbosity set to %d", VERBOSITY);
+
+  /* Query buffers are allocated by reactors but may be freed by executors. */
+  zmalloc_enable_thread_safeness();
+
+  populateCommandTable();
+
+  int ioThreads = (int)args["--io-threads"].asLong();
+  if (ioThreads < 1) {
+    serverLog(LL_ERROR, "--io-threads must be at least 1");
+    return -1;
+  }
+
+  int rpcWindow = (int)args["--rpc-window"].asLong();
+  if (rpcWindow < 1) {
+    serverLog(LL_ERROR, "--rpc-window must be at least 1");
+    return -1;
+  }
+
+  size_t queueSize = (size_t)args["--queue-size"].asLong();
+  clientMaxInflight = (uint32_t)args["--client-max-inflight"].asLong();
+  outputBufferSoftLimit = (size_t)args["--output-buffer-soft-limit"].asLong();
+  outputBufferHardLimit = (size_t)args["--output-buffer-hard-limit"].asLong();
+  traceSample = (uint32_t)args["--trace-sample"].asLong();
+  slowlogInit(args["--slowlog-log-slower-than"].asLong(),
+      (size_t)args["--slowlog-max-len"].asLong());
+  latencyInit((uint64_t)args["--latency-monitor-threshold"].asLong());
+  requestQ = new mpmcQueue<request>(queueSize);
+
+  cacheInit((size_t)args["--cache-size"].asLong(),
+      (uint64_t)args["--cache-ttl"].asLong());
+
+  /* Open a listening socket per reactor. They all bind the same port with
+   * SO_REUSEPORT, so the kernel balances new connections across them. */
+  for (int i = 0; i < ioThreads; i++) {
+    reactor *loop = new reactor(i, queueSize);
+    if (initReactor(loop, args["--host"].asString().c_str(),
+          args["--port"].asString().c_str()) == C_ERR) {
       return -1;
     }
+    reactors.push_back(loop);
+  }
 
-    /* Buffer up any unread client data. */
-    if (retval > 0) {
-      for (auto it = clientBuffers.begin(); it != clientBuffers.end(); ) {
-        int cfd = it->first;
-        clientBuffer *cBuf = &it->second;
-        if (FD_ISSET(cfd, &_cfds)) {
-          size_t qblen = sdslen(cBuf->querybuf);
-          cBuf->querybuf = sdsMakeRoomFor(cBuf->querybuf, PROTO_IOBUF_LEN);
-          int nbytes = read(cfd, cBuf->querybuf + qblen, PROTO_IOBUF_LEN);
-          if (nbytes == -1) {
-            if (errno == EAGAIN) {
-              /* That's fine, try again later. */
-              ++it;
-              continue;
-            } else {
-              /* Got an error. Close the client. */
-              serverLog(LL_ERROR, "Read error: %s. Closing client.", 
-                  strerror(errno));
-              it = clientBuffers.erase(it);
-              close(cfd);
-              FD_CLR(cfd, &cfds);
-              continue;
-            }
-          } else if (nbytes == 0) {
-            /* Client closed connection. */
-            serverLog(LL_INFO, "Client connection closed.");
-
-            it = clientBuffers.erase(it);
-            FD_CLR(cfd, &cfds);
-            continue;
-          } else {
-            /* Houston, we have data! */
-            sdsIncrLen(cBuf->querybuf, nbytes);
-            processInputBuffer(cBuf);
-            ++it;
-            continue;
-          }  
-        } else {
-          /* This client has no data. */
-          ++it;
-          continue;
-        }
-      }
-    } 
-
-    while (responseQ.size() > 0) {
-      int cfd;
-      std::string response;
-      {
-        std::lock_guard<std::mutex> lock(responseQMutex);
-        std::pair<int, std::string> entry = responseQ.front();
-        cfd = entry.first;
-        response = entry.second;
-        responseQ.pop();
-      }
-     
-      if (clientBuffers.find(cfd) != clientBuffers.end()) { 
-        int bufpos = 0;
-        const char* buf = response.c_str();
-        int buflen = response.length();
-        while (bufpos != buflen) {
-          int nwritten = write(cfd, buf + bufpos, buflen - bufpos);
-          if (nwritten == -1) {
-            if (errno == EAGAIN) {
-              /* Try again. */
-              continue;
-            } else {
-              /* Something bad happened. */
-              clientBuffers.erase(cfd);
-              close(cfd);
-              FD_CLR(cfd, &cfds);
-              break;
-            }
-          }
-          bufpos += nwritten;
-        }
-      } else {
-        /* Response is for a client that we already closed the connection for.
-         * */
-        continue;
+  /* Start request executor threads. */
+  int numExecutors = (int)args["--threads"].asLong();
+  if (numExecutors < 1) {
+    serverLog(LL_ERROR, "--threads must be at least 1");
+    return -1;
+  }
+  int fastExecutors = (int)args["--fast-threads"].asLong();
+  if (fastExecutors < 0 || (fastExecutors > 0 &&
+        fastExecutors >= numExecutors)) {
+    serverLog(LL_ERROR, "--fast-threads must leave at least one of the "
+        "--threads for slow commands");
+    return -1;
+  }
+  if (fastExecutors > 0 && args["--key-affinity"].asBool()) {
+    serverLog(LL_ERROR, "--fast-threads and --key-affinity can't be used "
+        "together");
+    return -1;
+  }
+
+  if (args["--key-affinity"].asBool()) {
+    for (int i = 0; i < numExecutors; i++)
+      executorQs.push_back(new mpmcQueue<request>(queueSize));
+  }
+  if (fastExecutors > 0) {
+    fastQ = new mpmcQueue<request>(queueSize);
+    slowQ = new mpmcQueue<request>(queueSize, &slowEvents);
+  }
+
+  std::string admitAction = args["--admit-action"].asString();
+  if (admitAction != "busy" && admitAction != "pause") {
+    serverLog(LL_ERROR, "--admit-action must be busy or pause");
+    return -1;
+  }
+  admissionInit((uint64_t)args["--admit-max-queued"].asLong(),
+      (uint64_t)args["--admit-max-p99-us"].asLong(),
+      admitAction == "pause" ? ADMIT_PAUSE : ADMIT_BUSY, numExecutors);
+  commandStatsInit(numExecutors);
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < numExecutors; i++) {
+    std::vector<mpmcQueue<request>*> queues;
+    eventCount *notEmpty = NULL;
+    if (fastQ != NULL) {
+      queues.push_back(fastQ);
+      if (i >= fastExecutors) {
+        queues.push_back(slowQ);
+        notEmpty = &slowEvents;
       }
+    } else {
+      queues.push_back(executorQs.empty() ? requestQ : executorQs[i]);
     }
+    threads.emplace_back(requestExecutor, i,
+        args["RAMCLOUDCOORDLOC"].asString().c_str(), rpcWindow, queues,
+        notEmpty);
+  }
+
+  /* Start the extra I/O threads. The main thread runs the first reactor. */
+  for (int i = 1; i < ioThreads; i++) {
+    threads.emplace_back(reactorThread, reactors[i]);
   }
 
-  return 0;
+  runReactor(reactors[0]);
+
+  return -1;
 }
+
+#endif // RAMDIS_SERVER_TEST
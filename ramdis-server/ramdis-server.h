@@ -3,13 +3,28 @@
 
 #include <string>
 #include <vector>
+#include <deque>
+#include <unordered_map>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <time.h>
 
 #include "sds.h"
+#include "mpmcqueue.h"
+#include "histogram.h"
 #include "RamCloud.h"
 
 #define CONFIG_DEFAULT_TCP_BACKLOG       511     /* TCP listen backlog */
 #define PROTO_IOBUF_LEN         (1024*16)  /* Generic I/O buffer size */
 #define NET_IP_STR_LEN 46 /* INET6_ADDRSTRLEN is 46, but we need to be sure */
+#define MAX_EPOLL_EVENTS 1024 /* Max events returned by one epoll_wait() */
+#define PIPELINE_MAX_PENDING 1024 /* Max unanswered requests per client */
+#define NET_MAX_WRITEV_IOV 128 /* Max replies written by one writev() */
+#define REQUEST_BATCH_MAX 128 /* Max pipelined requests run as one request */
+#define CLIENT_QUANTUM 16 /* Requests a client may dispatch per round */
+#define CLIENT_LIST_WAIT_MS 100 /* Max wait for a reactor's CLIENT LIST */
 
 #define LOG_MAX_LEN    1024 /* Default maximum length of syslog messages */
 
@@ -32,7 +47,7 @@
 
 /* Protocol and I/O related defines */
 #define PROTO_INLINE_MAX_SIZE   (1024*64) /* Max size of inline reads */
-#define PROTO_MBULK_BIG_ARG     (1024*32)
+#define PROTO_MBULK_BIG_ARG     (1024*32) /* Read into a buffer of its own */
 
 /* Error codes */
 #define C_OK                    0
@@ -40,29 +55,352 @@
 
 #define serverPanic(_e) _serverPanic(#_e,__FILE__,__LINE__),_exit(1)
 
+/* Command flags. Please check the command table defined in the
+ * ramdis-server.cc file for more information about the meaning of every
+ * flag. */
+#define CMD_WRITE 1                   /* "w" flag */
+#define CMD_READONLY 2                /* "r" flag */
+#define CMD_DENYOOM 4                 /* "m" flag */
+#define CMD_FORCE_REPLICATION 8       /* "f" flag */
+#define CMD_ADMIN 16                  /* "a" flag */
+#define CMD_PUBSUB 32                 /* "p" flag */
+#define CMD_NOSCRIPT  64              /* "s" flag */
+#define CMD_RANDOM 128                /* "R" flag */
+#define CMD_SORT_FOR_SCRIPT 256       /* "S" flag */
+#define CMD_LOADING 512               /* "l" flag */
+#define CMD_STALE 1024                /* "t" flag */
+#define CMD_SKIP_MONITOR 2048         /* "M" flag */
+#define CMD_ASKING 4096               /* "k" flag */
+#define CMD_FAST 8192                 /* "F" flag */
+#define CMD_TRANSACTION 16384         /* "T" flag */
+
+/* Object types. Every value stored in RAMCloud starts with an ObjectMetadata
+ * header holding its type, so that a string is never taken for a list or the
+ * other way around. */
+#define REDIS_STRING 0
+#define REDIS_LIST 2
+
+struct ObjectMetadata {
+  uint8_t type;
+};
+
+#define WRONGTYPE_ERR \
+  "-WRONGTYPE Operation against a key holding the wrong kind of value"
+
+struct clientBuffer;
+struct reactor;
+struct redisCommand;
+
+/* Buffer that client input is read into. Request arguments point straight
+ * into it, so it is reference counted, and only freed, trimmed or moved once
+ * the client is the last one holding it. */
+struct queryBuffer {
+  queryBuffer() : buf(sdsempty()) {}
+  explicit queryBuffer(sds buf) : buf(buf) {}
+  ~queryBuffer() { sdsfree(buf); }
+  queryBuffer(const queryBuffer&) = delete;
+  queryBuffer& operator=(const queryBuffer&) = delete;
+  sds buf;
+};
+
+/* A request argument: a view of bytes in a query buffer that the request
+ * holds a reference to. Arguments are always followed by the "\r\n" of the
+ * protocol, so atoi() and friends can be used on them directly, but they are
+ * not null terminated. */
+struct argView {
+  argView() : ptr(NULL), len(0) {}
+  argView(const char *ptr, size_t len) : ptr(ptr), len(len) {}
+  const char *data() const { return ptr; }
+  size_t length() const { return len; }
+  size_t size() const { return len; }
+  std::string str() const { return std::string(ptr, len); }
+  const char *ptr;
+  size_t len;
+};
+
+/* Cycles::rdtsc() when a request reached each stage of its way through the
+ * server, or 0 if it hasn't. */
+struct requestTimes {
+  requestTimes() : parsedAt(0), queuedAt(0), dequeuedAt(0), executedAt(0) {}
+  uint64_t parsedAt;      /* The reactor finished parsing it. */
+  uint64_t queuedAt;      /* Put in a request queue. */
+  uint64_t dequeuedAt;    /* Taken off it by an executor. */
+  uint64_t executedAt;    /* Its reply was put in the response queue. */
+};
+
+/* Stages timed between those stamps and the write of the reply. */
+#define STAGE_DISPATCH 0  /* Held behind its keys or by the scheduler. */
+#define STAGE_QUEUE 1     /* In the request queue. */
+#define STAGE_EXECUTE 2   /* Executing, RAMCloud RPCs included. */
+#define STAGE_REPLY 3     /* In the response queue or output buffer. */
+#define STAGE_TOTAL 4     /* From parsed to written. */
+#define NUM_STAGES 5
+
+/* A command that went in the slow log. The executor fills in the command
+ * line, the reactor the rest once the reply is written. See slowlog.h. */
+struct slowlogEntry {
+  slowlogEntry() : id(0), time(0), argv(), addr(), stages() {}
+  uint64_t id;
+  time_t time;                   /* When it was executed. */
+  std::vector<std::string> argv; /* Shortened, as in Redis. */
+  std::string addr;              /* ip:port of the client. */
+  uint64_t stages[NUM_STAGES];   /* Microseconds, per STAGE_*. */
+};
+
+/* The slow log of a reactor, newest entry first. It has a lock of its own,
+ * so that SLOWLOG doesn't wait for a reactor that is busy with its clients.
+ * Entries are shared and never change once in the log, so the lock is only
+ * held to add, copy or drop pointers, and entries are built and freed outside
+ * it. */
+struct slowlogList {
+  slowlogList() : lock(), entries() {}
+  std::mutex lock;
+  std::deque<std::shared_ptr<const slowlogEntry>> entries;
+};
+
+/* A parsed request waiting in the request queue for an executor. A run of
+ * pipelined GETs or SETs from one client travels as a single request, so that
+ * one executor can issue them as one multi-object RPC. Its argv then holds the
+ * arguments of each of them in turn, and it answers batchSize consecutive
+ * sequence numbers starting at seq. */
+struct request {
+  request() : loop(NULL), fd(-1), clientId(0), seq(0), cmd(NULL), argv(),
+    bufs(), batchSize(1), times(), slow() {}
+  request(reactor *loop, int fd, uint64_t clientId, uint64_t seq,
+      redisCommand *cmd, std::vector<argView> &&argv,
+      std::vector<std::shared_ptr<queryBuffer>> &&bufs) :
+    loop(loop),
+    fd(fd),
+    clientId(clientId),
+    seq(seq),
+    cmd(cmd),
+    argv(std::move(argv)),
+    bufs(std::move(bufs)),
+    batchSize(1),
+    times(),
+    slow() {}
+  reactor *loop;          /* Reactor to send the response back through. */
+  int fd;
+  uint64_t clientId;      /* Tells a reused fd apart from the original. */
+  uint64_t seq;           /* Position in the client's pipeline. */
+  redisCommand *cmd;      /* NULL if argv[0] is not a known command. */
+  std::vector<argView> argv;
+  /* Query buffers argv points into. Usually just one. */
+  std::vector<std::shared_ptr<queryBuffer>> bufs;
+  uint32_t batchSize;     /* Number of requests folded into this one. */
+  requestTimes times;
+  std::unique_ptr<slowlogEntry> slow; /* Set if it was slow to execute. */
+};
+
+/* A response waiting in a reactor's response queue to be written out. */
+struct response {
+  response() : fd(-1), clientId(0), seq(0), count(0), reply(), times(),
+    slow() {}
+  response(int fd, uint64_t clientId, uint64_t seq, uint32_t count,
+      std::string &&reply) :
+    fd(fd),
+    clientId(clientId),
+    seq(seq),
+    count(count),
+    reply(std::move(reply)),
+    times(),
+    slow() {}
+  int fd;
+  uint64_t clientId;
+  uint64_t seq;
+  /* Requests answered, starting at seq. 0 if this is only the first part
+   * of the reply to seq, and more is coming. */
+  uint32_t count;
+  std::string reply;      /* Their replies, one after the other. */
+  requestTimes times;     /* Of the first request, unless count is 0. */
+  std::unique_ptr<slowlogEntry> slow; /* Likewise. */
+};
+
+/* Pipeline entry states. */
+#define PIPELINE_HELD 1       /* Waiting for an earlier request on its keys. */
+#define PIPELINE_READY 2      /* Waiting for room in the request queue. */
+#define PIPELINE_DISPATCHED 3 /* In the request queue or executing. */
+#define PIPELINE_DONE 4       /* Reply is in, waiting for its turn to go out. */
+
+/* Results of dispatchReadyRequests(). */
+#define DISPATCH_DONE 0       /* No ready requests left. */
+#define DISPATCH_DEFICIT 1    /* Out of deficit for this round. */
+#define DISPATCH_LIMIT 2      /* At the in-flight limit. */
+#define DISPATCH_FULL 3       /* The request queue is full. */
+
+/* A request in a client's pipeline. A request is handed to the executors as
+ * soon as no earlier request from the same client still uses any of its keys,
+ * so requests on independent keys run in parallel, but replies are written
+ * strictly in the order the requests came in. */
+struct pipelineEntry {
+  pipelineEntry() : state(PIPELINE_HELD), req(), keys(), reply(), times(),
+    slow() {}
+  int state;
+  request req;            /* Valid while held or ready. */
+  std::vector<std::string> keys;
+  std::string reply;      /* Whatever part of the reply is in. */
+  requestTimes times;     /* Valid once done. */
+  std::unique_ptr<slowlogEntry> slow;
+};
+
+/* A reply that ends at byte end of everything written to a client, and the
+ * times of its request, to be recorded once that much has been written. */
+struct replyMark {
+  replyMark(uint64_t end, const requestTimes &times,
+      std::unique_ptr<slowlogEntry> &&slow) :
+    end(end),
+    times(times),
+    slow(std::move(slow)) {}
+  uint64_t end;
+  requestTimes times;
+  std::unique_ptr<slowlogEntry> slow;
+};
+
+/* A client as CLIENT LIST shows it. */
+struct clientInfo {
+  clientInfo() : id(0), addr(), fd(-1), ctime(0), qbuf(0), pipeline(0),
+    ready(0), inflight(0), deficit(0), omem(0) {}
+  uint64_t id;
+  std::string addr;
+  int fd;
+  time_t ctime;
+  size_t qbuf;
+  size_t pipeline;
+  size_t ready;
+  uint32_t inflight;
+  uint32_t deficit;
+  size_t omem;
+};
+
+/* An I/O thread. Each reactor has its own listening socket bound with
+ * SO_REUSEPORT, its own epoll instance and client table, and its own queue of
+ * responses that executors fill in for its clients. */
+struct reactor {
+  reactor(int id, size_t queueSize) :
+    id(id),
+    sfd(-1),
+    epfd(-1),
+    eventfd(-1),
+    nextClientId(1),
+    clients(),
+    clientsToClose(),
+    readyClients(),
+    clientsPendingWrite(),
+    overloadPausedClients(),
+    responseQ(queueSize),
+    notifyPending(false),
+    clientListWanted(0),
+    clientListLock(),
+    clientListTaken(),
+    clientListTakenFor(0),
+    clientListSnapshot(),
+    stageTimes(),
+    timedRequests(0),
+    slowlog() {}
+  int id;
+  int sfd;                /* Listening socket. */
+  int epfd;
+  int eventfd;            /* Signalled by executors after queueing a response. */
+  uint64_t nextClientId;
+  std::vector<clientBuffer*> clients; /* Indexed by file descriptor. */
+  std::vector<int> clientsToClose; /* See freeClientAsync(). */
+  /* Clients with ready requests to dispatch, in round robin order. */
+  std::deque<int> readyClients;
+  /* Clients with replies to write before we go back to epoll_wait(). */
+  std::vector<int> clientsPendingWrite;
+  /* Clients not read from until the server is no longer overloaded. */
+  std::vector<int> overloadPausedClients;
+  mpmcQueue<response> responseQ;
+  std::atomic<bool> notifyPending; /* An eventfd wakeup is on its way. */
+  /* Snapshot of the clients for CLIENT LIST, taken when an executor asks
+   * for one, so that executors never touch the reactor's own state. See
+   * takeClientList(). */
+  std::atomic<uint64_t> clientListWanted; /* Snapshots asked for so far. */
+  std::mutex clientListLock;
+  std::condition_variable clientListTaken;
+  uint64_t clientListTakenFor; /* Value of clientListWanted it answers. */
+  std::vector<clientInfo> clientListSnapshot;
+  histogram stageTimes[NUM_STAGES]; /* Microseconds, per STAGE_*. */
+  uint64_t timedRequests;
+  slowlogList slowlog;    /* Of this reactor's clients. */
+};
+
 /* Used to store client data coming in over the socket and parsing state as the
  * buffer is incrementally parsed for commands. */
 struct clientBuffer {
-  clientBuffer(int fd) : 
+  clientBuffer(int fd, reactor *loop) : 
     fd(fd),
-    querybuf(sdsempty()),
+    id(loop->nextClientId++),
+    loop(loop),
+    addr(),
+    ctime(time(NULL)),
+    closeAsap(false),
+    readPaused(false),
+    overloadPaused(false),
+    querybuf(std::make_shared<queryBuffer>()),
+    qb_pos(0),
     argv(),
+    argvBufs(),
     reqtype(0),
     multibulklen(0),
-    bulklen(-1) {}
-  // TODO: write destructor
+    bulklen(-1),
+    pipeline(),
+    pipelineBase(0),
+    keyWaiters(),
+    readyQ(),
+    inReadyClients(false),
+    inflight(0),
+    deficit(0),
+    reply(),
+    replyBytes(0),
+    sentlen(0),
+    replyOffset(0),
+    sentOffset(0),
+    replyMarks(),
+    pendingWrite(false),
+    writeHandlerInstalled(false) {}
+  clientBuffer(const clientBuffer&) = delete;
+  clientBuffer& operator=(const clientBuffer&) = delete;
   int fd;
-  sds querybuf;           /* Buffer we use to accumulate client queries. */
-  std::vector<std::string> argv; /* Arguments of current command. */
+  uint64_t id;
+  reactor *loop;          /* Reactor owning this connection. */
+  std::string addr;       /* ip:port of the peer. */
+  time_t ctime;           /* When the connection was accepted. */
+  bool closeAsap;         /* Free at the end of the event loop iteration. */
+  bool readPaused;        /* Stopped parsing until ready requests drain. */
+  bool overloadPaused;    /* Listed in loop->overloadPausedClients. */
+  /* Buffer we use to accumulate client queries. */
+  std::shared_ptr<queryBuffer> querybuf;
+  size_t qb_pos;          /* Start of the unparsed part of querybuf. */
+  std::vector<argView> argv; /* Arguments of current command. */
+  /* Query buffers argv points into. */
+  std::vector<std::shared_ptr<queryBuffer>> argvBufs;
   int reqtype;
   int multibulklen;
   long bulklen;
+  /* Requests that haven't had their reply written yet, oldest first. */
+  std::deque<pipelineEntry> pipeline;
+  uint64_t pipelineBase;  /* Sequence number of pipeline.front(). */
+  /* For each key used by a request in the pipeline, the sequence numbers of
+   * those requests, oldest first. Only the oldest may run. */
+  std::unordered_map<std::string, std::deque<uint64_t>> keyWaiters;
+  std::deque<uint64_t> readyQ; /* Sequence numbers of ready requests. */
+  bool inReadyClients;    /* Listed in loop->readyClients. */
+  uint32_t inflight;      /* Requests dispatched but not answered yet. */
+  uint32_t deficit;       /* Requests it may still dispatch this round. */
+  std::deque<std::string> reply; /* Replies waiting to be written. */
+  size_t replyBytes;      /* Unwritten bytes in reply. */
+  size_t sentlen;         /* Bytes of reply.front() already written. */
+  uint64_t replyOffset;   /* Bytes ever added to reply. */
+  uint64_t sentOffset;    /* Bytes ever written. */
+  std::deque<replyMark> replyMarks; /* Oldest first. */
+  bool pendingWrite;      /* Listed in loop->clientsPendingWrite. */
+  bool writeHandlerInstalled; /* Watching for EPOLLOUT. */
 };
 
-typedef std::string redisCommandProc(RAMCloud::RamCloud *client, 
-    uint64_t tableId,
-    std::vector<std::string> *argv);
-typedef int *redisGetKeysProc(struct redisCommand *cmd, std::vector<std::string> *argv, int *numkeys);
+struct commandContext;
+typedef void redisCommandProc(commandContext *c);
+typedef int *redisGetKeysProc(struct redisCommand *cmd, std::vector<argView> *argv, int *numkeys);
 struct redisCommand {
     const char *name;
     redisCommandProc *proc;
@@ -79,4 +417,28 @@ struct redisCommand {
     long long microseconds, calls;
 };
 
+extern struct redisCommand redisCommandTable[];
+
+/* Prototypes */
+void serverLog(int level, const char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+void populateCommandTable(void);
+int commandCount();
+struct redisCommand *lookupCommand(const char *name, size_t len);
+void submitCommand(clientBuffer *c);
+void scheduleClient(clientBuffer *c);
+void dispatchReadyClients(reactor *loop);
+void addCompletedReplies(clientBuffer *c);
+void sendPartialResponse(request *req, std::string &&reply);
+int string2ll(const char *s, size_t slen, long long *value);
+void lanesInfo(std::string *info);
+void stagesInfo(std::string *info);
+void slowlogEntries(
+    std::vector<std::shared_ptr<const slowlogEntry>> *entries);
+size_t slowlogLength();
+void slowlogReset();
+void takeClientList(reactor *loop);
+void clientList(std::string *list);
+size_t queuedRequests();
+
 #endif // __RAMDIS_SERVER_H
@@ -0,0 +1,148 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "reply.h"
+
+/* Append raw protocol to the reply. */
+void addReplyString(replyBuffer *r, const char *s, size_t len) {
+  r->buf.append(s, len);
+}
+
+/* Add a simple string reply, e.g. "+OK\r\n". */
+void addReplyStatus(replyBuffer *r, const char *status) {
+  r->buf += '+';
+  r->buf.append(status);
+  r->buf.append("\r\n", 2);
+}
+
+/* Add an error reply. Like Redis, an error that doesn't start with its own
+ * "-CODE" gets "-ERR". Newlines would break the protocol, so they become
+ * spaces. */
+void addReplyError(replyBuffer *r, const char *err) {
+  if (err[0] != '-')
+    r->buf.append("-ERR ", 5);
+  size_t start = r->buf.size();
+  r->buf.append(err);
+  for (size_t i = start; i < r->buf.size(); i++) {
+    if (r->buf[i] == '\r' || r->buf[i] == '\n')
+      r->buf[i] = ' ';
+  }
+  r->buf.append("\r\n", 2);
+}
+
+void addReplyErrorFormat(replyBuffer *r, const char *fmt, ...) {
+  char err[256];
+  va_list ap;
+  va_start(ap, fmt);
+  vsnprintf(err, sizeof(err), fmt, ap);
+  va_end(ap);
+  addReplyError(r, err);
+}
+
+/* Add a prefix character followed by a number and CRLF, e.g. "*3\r\n". */
+static void addReplyLongLongWithPrefix(replyBuffer *r, char prefix,
+    long long ll) {
+  char buf[32];
+  buf[0] = prefix;
+  int len = ll2string(buf + 1, sizeof(buf) - 1, ll);
+  buf[len + 1] = '\r';
+  buf[len + 2] = '\n';
+  r->buf.append(buf, len + 3);
+}
+
+void addReplyLongLong(replyBuffer *r, long long ll) {
+  addReplyLongLongWithPrefix(r, ':', ll);
+}
+
+void addReplyArrayLen(replyBuffer *r, long long len) {
+  addReplyLongLongWithPrefix(r, '*', len);
+}
+
+/* Add the header of a bulk reply. The caller appends exactly len bytes of
+ * payload and then "\r\n". */
+void addReplyBulkLen(replyBuffer *r, size_t len) {
+  addReplyLongLongWithPrefix(r, '$', (long long)len);
+}
+
+void addReplyBulk(replyBuffer *r, const char *p, size_t len) {
+  addReplyBulkLen(r, len);
+  r->buf.append(p, len);
+  r->buf.append("\r\n", 2);
+}
+
+/* The nil bulk reply, e.g. for a GET of a missing key. */
+void addReplyNull(replyBuffer *r) {
+  r->buf.append("$-1\r\n", 5);
+}
+
+/* Take the reply encoded so far, leaving the buffer empty for the next one.
+ * Small replies are copied out, so the buffer keeps its capacity, and the
+ * smallest ones (like "+OK" or short integers) fit in the string itself
+ * without an allocation. Big replies take the buffer along instead of being
+ * copied, and the buffer is allocated again. */
+std::string takeReply(replyBuffer *r) {
+  std::string reply;
+  if (r->buf.size() <= REPLY_BUFFER_SIZE) {
+    reply.assign(r->buf.data(), r->buf.size());
+    r->buf.clear();
+  } else {
+    reply.swap(r->buf);
+    r->buf.reserve(REPLY_BUFFER_SIZE);
+  }
+  return reply;
+}
+
+/* Convert a long long into a string, returning its length, or 0 if dst is too
+ * small. Converts two digits at a time from a lookup table, as in Redis. */
+int ll2string(char *dst, size_t dstlen, long long svalue) {
+  static const char digits[201] =
+    "0001020304050607080910111213141516171819"
+    "2021222324252627282930313233343536373839"
+    "4041424344454647484950515253545556575859"
+    "6061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+  unsigned long long value;
+  int negative;
+
+  /* The absolute value of LLONG_MIN doesn't fit in a long long, so do the
+   * conversion on an unsigned. */
+  if (svalue < 0) {
+    value = -(unsigned long long)svalue;
+    negative = 1;
+  } else {
+    value = svalue;
+    negative = 0;
+  }
+
+  /* Count the digits. */
+  uint32_t length = 1;
+  for (unsigned long long v = value; v >= 10; v /= 10)
+    length++;
+
+  /* Check the length and add the sign. */
+  uint32_t resultlen = length + negative;
+  if (resultlen >= dstlen)
+    return 0;
+  if (negative)
+    dst[0] = '-';
+
+  /* Fill in the digits, last to first. */
+  char *p = dst + resultlen;
+  *p = '\0';
+  while (value >= 100) {
+    int const i = (value % 100) * 2;
+    value /= 100;
+    *--p = digits[i + 1];
+    *--p = digits[i];
+  }
+
+  if (value < 10) {
+    *--p = '0' + (uint32_t)value;
+  } else {
+    int i = (uint32_t)value * 2;
+    *--p = digits[i + 1];
+    *--p = digits[i];
+  }
+  return resultlen;
+}
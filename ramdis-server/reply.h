@@ -0,0 +1,32 @@
+#ifndef __REPLY_H
+#define __REPLY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+/* Initial capacity of a reply buffer. Replies up to this size are copied out
+ * of it, bigger ones take the buffer with them. */
+#define REPLY_BUFFER_SIZE (1024*16)
+
+/* Buffer that command replies are encoded into, one per executor thread.
+ * Commands append RESP directly with the addReply*() functions below, and the
+ * executor takes the finished reply with takeReply(). */
+struct replyBuffer {
+  replyBuffer() : buf() { buf.reserve(REPLY_BUFFER_SIZE); }
+  std::string buf;
+};
+
+void addReplyString(replyBuffer *r, const char *s, size_t len);
+void addReplyStatus(replyBuffer *r, const char *status);
+void addReplyError(replyBuffer *r, const char *err);
+void addReplyErrorFormat(replyBuffer *r, const char *fmt, ...);
+void addReplyLongLong(replyBuffer *r, long long ll);
+void addReplyArrayLen(replyBuffer *r, long long len);
+void addReplyBulkLen(replyBuffer *r, size_t len);
+void addReplyBulk(replyBuffer *r, const char *p, size_t len);
+void addReplyNull(replyBuffer *r);
+std::string takeReply(replyBuffer *r);
+int ll2string(char *dst, size_t dstlen, long long svalue);
+
+#endif // __REPLY_H
@@ -0,0 +1,61 @@
+#include <stdio.h>
+#include <time.h>
+#include <atomic>
+#include <mutex>
+
+#include "slowlog.h"
+#include "Cycles.h"
+
+using RAMCloud::Cycles;
+
+uint64_t slowlogSlowerThan = UINT64_MAX;
+static size_t maxLen;
+static std::atomic<uint64_t> nextId(0);
+
+/* A negative threshold turns the slow log off, and 0 logs every command. */
+void slowlogInit(long long slowerThanUs, size_t len) {
+  maxLen = len;
+  if (slowerThanUs >= 0 && len > 0)
+    slowlogSlowerThan = Cycles::fromNanoseconds(slowerThanUs * 1000);
+}
+
+/* Start an entry for a request that was just executed. Long arguments are
+ * cut short and only the first SLOWLOG_ENTRY_MAX_ARGC are kept, with the
+ * last of those saying how many more there were. */
+std::unique_ptr<slowlogEntry> slowlogCreate(const request &req) {
+  std::unique_ptr<slowlogEntry> entry(new slowlogEntry());
+  entry->id = nextId.fetch_add(1, std::memory_order_relaxed);
+  entry->time = time(NULL);
+
+  size_t argc = req.argv.size();
+  size_t kept = argc > SLOWLOG_ENTRY_MAX_ARGC ? SLOWLOG_ENTRY_MAX_ARGC : argc;
+  for (size_t i = 0; i < kept; i++) {
+    char buf[64];
+    if (kept != argc && i == kept - 1) {
+      snprintf(buf, sizeof(buf), "... (%zu more arguments)", argc - kept + 1);
+      entry->argv.push_back(buf);
+    } else if (req.argv[i].length() > SLOWLOG_ENTRY_MAX_STRING) {
+      snprintf(buf, sizeof(buf), "... (%zu more bytes)",
+          req.argv[i].length() - SLOWLOG_ENTRY_MAX_STRING);
+      entry->argv.push_back(std::string(req.argv[i].data(),
+            SLOWLOG_ENTRY_MAX_STRING) + buf);
+    } else {
+      entry->argv.push_back(req.argv[i].str());
+    }
+  }
+  return entry;
+}
+
+/* Add a finished entry to the front of a reactor's log, dropping the oldest
+ * one if that makes it too long. The entry is made shared, and the dropped
+ * one freed, outside the lock. */
+void slowlogPush(slowlogList *log, std::unique_ptr<slowlogEntry> entry) {
+  std::shared_ptr<const slowlogEntry> shared(std::move(entry));
+  std::shared_ptr<const slowlogEntry> dropped;
+  std::lock_guard<std::mutex> guard(log->lock);
+  log->entries.push_front(std::move(shared));
+  if (log->entries.size() > maxLen) {
+    dropped = std::move(log->entries.back());
+    log->entries.pop_back();
+  }
+}
@@ -0,0 +1,39 @@
+#ifndef __SLOWLOG_H
+#define __SLOWLOG_H
+
+#include <stdint.h>
+#include <memory>
+#include <deque>
+
+#include "ramdis-server.h"
+
+/* Slow log of commands that took longer than --slowlog-log-slower-than to
+ * execute, as in Redis. The executor that ran such a command takes down its
+ * arguments and hands the entry back with the reply. The reactor fills in the
+ * client's address and the stage times once the reply is written out, and
+ * keeps the entry in a log of its own. Each log has its own lock, which
+ * SLOWLOG takes to read or clear it; it only ever contends with the reactor
+ * adding an entry, never with the rest of its event loop. Either side holds
+ * it only to move entry pointers: SLOWLOG GET copies the pointers, and
+ * entries are built and freed with the lock let go.
+ *
+ * Commands under the threshold cost a comparison and carry a NULL pointer
+ * with their response. */
+
+#define SLOWLOG_ENTRY_MAX_ARGC 32    /* Arguments kept per entry. */
+#define SLOWLOG_ENTRY_MAX_STRING 128 /* Bytes kept per argument. */
+
+/* Execution time in cycles from which on commands are logged, UINT64_MAX if
+ * the slow log is off. */
+extern uint64_t slowlogSlowerThan;
+
+void slowlogInit(long long slowerThanUs, size_t maxLen);
+std::unique_ptr<slowlogEntry> slowlogCreate(const request &req);
+void slowlogPush(slowlogList *log, std::unique_ptr<slowlogEntry> entry);
+
+/* Whether a command that took cycles to execute goes in the slow log. */
+static inline bool slowlogIsSlow(uint64_t cycles) {
+  return cycles >= slowlogSlowerThan;
+}
+
+#endif // __SLOWLOG_H
@@ -0,0 +1,214 @@
+#include <unistd.h>
+#include <functional>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include "cache.h"
+
+// Each test gets shard bytes of 1000, and entries that cost 200 each, so a
+// shard holds exactly five of them.
+#define SHARD_BYTES 1000
+#define ENTRY_COST 200
+
+// Returns count keys starting with prefix that all fall in shard, so that
+// tests see one CLOCK and one epoch, and don't share them with each other.
+static std::vector<std::string> keysInShard(const std::string &prefix,
+    size_t shard, size_t count) {
+  std::vector<std::string> keys;
+  for (int i = 0; keys.size() < count; i++) {
+    std::string k = prefix + std::to_string(i);
+    if (std::hash<std::string>()(k) % CACHE_SHARDS == shard)
+      keys.push_back(k);
+  }
+  return keys;
+}
+
+static std::string replyFor(const std::string &key, char c) {
+  return std::string(ENTRY_COST - CACHE_ENTRY_OVERHEAD - key.size(), c);
+}
+
+static int lookup(const std::string &key, cacheProbe *probe) {
+  cacheLookup(argView(key.data(), key.size()), probe);
+  return probe->result;
+}
+
+// Inserts what a miss on key would read from RAMCloud.
+static void insert(const std::string &key, char c, uint64_t version) {
+  cacheProbe probe;
+  lookup(key, &probe);
+  std::string reply = replyFor(key, c);
+  cacheInsert(argView(key.data(), key.size()), probe, reply.data(),
+      reply.size(), version);
+}
+
+TEST(CacheTest, hitAndMiss) {
+  cacheInit(SHARD_BYTES * CACHE_SHARDS, 0);
+  EXPECT_TRUE(cacheEnabled());
+  std::vector<std::string> keys = keysInShard("hit", 0, 1);
+
+  cacheProbe probe;
+  EXPECT_EQ(CACHE_MISS, lookup(keys[0], &probe));
+  insert(keys[0], 'a', 7);
+  EXPECT_EQ(CACHE_HIT, lookup(keys[0], &probe));
+  EXPECT_EQ(replyFor(keys[0], 'a'), *probe.reply);
+  EXPECT_EQ(7U, probe.version);
+
+  cacheInvalidate(argView(keys[0].data(), keys[0].size()));
+  EXPECT_EQ(CACHE_MISS, lookup(keys[0], &probe));
+}
+
+// The hand spares entries hit since it last came by, and evicts the first
+// one that wasn't.
+TEST(CacheTest, clockEviction) {
+  cacheInit(SHARD_BYTES * CACHE_SHARDS, 0);
+  std::vector<std::string> keys = keysInShard("clock", 1, 7);
+
+  for (int i = 0; i < 5; i++)
+    insert(keys[i], 'a', 1);
+  cacheProbe probe;
+  for (int i = 0; i < 5; i++)
+    ASSERT_EQ(CACHE_HIT, lookup(keys[i], &probe));
+
+  // Every entry has been hit once now. Hit two of them once more.
+  EXPECT_EQ(CACHE_HIT, lookup(keys[0], &probe));
+  EXPECT_EQ(CACHE_HIT, lookup(keys[2], &probe));
+
+  // The first sweep takes a hit from each entry, and the second evicts the
+  // first one left with none, key 1.
+  insert(keys[5], 'a', 1);
+  EXPECT_EQ(CACHE_MISS, lookup(keys[1], &probe));
+  EXPECT_EQ(CACHE_HIT, lookup(keys[0], &probe));
+  EXPECT_EQ(CACHE_HIT, lookup(keys[2], &probe));
+  EXPECT_EQ(CACHE_HIT, lookup(keys[3], &probe));
+  EXPECT_EQ(CACHE_HIT, lookup(keys[4], &probe));
+  EXPECT_EQ(CACHE_HIT, lookup(keys[5], &probe));
+
+  // The hand goes on from key 2, which has been hit twice since it last
+  // came by, and evicts key 3 on its second sweep.
+  insert(keys[6], 'a', 1);
+  EXPECT_EQ(CACHE_HIT, lookup(keys[6], &probe));
+  EXPECT_EQ(CACHE_MISS, lookup(keys[3], &probe));
+  EXPECT_EQ(CACHE_HIT, lookup(keys[2], &probe));
+}
+
+// Replies too big for a quarter of the shard are not cached at all.
+TEST(CacheTest, tooBig) {
+  cacheInit(SHARD_BYTES * CACHE_SHARDS, 0);
+  std::vector<std::string> keys = keysInShard("big", 2, 1);
+
+  cacheProbe probe;
+  lookup(keys[0], &probe);
+  std::string reply(SHARD_BYTES / 4, 'x');
+  cacheInsert(argView(keys[0].data(), keys[0].size()), probe, reply.data(),
+      reply.size(), 1);
+  EXPECT_EQ(CACHE_MISS, lookup(keys[0], &probe));
+}
+
+// A write to any key of the shard between the lookup and the insert may
+// have been to this one, so the insert is dropped.
+TEST(CacheTest, epoch) {
+  cacheInit(SHARD_BYTES * CACHE_SHARDS, 0);
+  std::vector<std::string> keys = keysInShard("epoch", 3, 2);
+  std::vector<std::string> other = keysInShard("epoch", 4, 1);
+  std::string reply = replyFor(keys[0], 'a');
+  argView key(keys[0].data(), keys[0].size());
+
+  cacheProbe probe;
+  lookup(keys[0], &probe);
+  cacheInvalidate(argView(keys[1].data(), keys[1].size()));
+  cacheInsert(key, probe, reply.data(), reply.size(), 1);
+  EXPECT_EQ(CACHE_MISS, lookup(keys[0], &probe));
+
+  // Writes in other shards don't matter.
+  cacheInvalidate(argView(other[0].data(), other[0].size()));
+  cacheInsert(key, probe, reply.data(), reply.size(), 1);
+  EXPECT_EQ(CACHE_HIT, lookup(keys[0], &probe));
+}
+
+// A reply read at an older version than the cached one never replaces it.
+TEST(CacheTest, versions) {
+  cacheInit(SHARD_BYTES * CACHE_SHARDS, 0);
+  std::vector<std::string> keys = keysInShard("version", 5, 1);
+
+  insert(keys[0], 'b', 5);
+  insert(keys[0], 'a', 3);
+  cacheProbe probe;
+  EXPECT_EQ(CACHE_HIT, lookup(keys[0], &probe));
+  EXPECT_EQ(5U, probe.version);
+  EXPECT_EQ(replyFor(keys[0], 'b'), *probe.reply);
+
+  insert(keys[0], 'c', 9);
+  EXPECT_EQ(CACHE_HIT, lookup(keys[0], &probe));
+  EXPECT_EQ(9U, probe.version);
+  EXPECT_EQ(replyFor(keys[0], 'c'), *probe.reply);
+}
+
+// Entries older than the TTL have to be revalidated, after which they are
+// good for another TTL.
+TEST(CacheTest, ttl) {
+  cacheInit(SHARD_BYTES * CACHE_SHARDS, 1);
+  std::vector<std::string> keys = keysInShard("ttl", 6, 1);
+  argView key(keys[0].data(), keys[0].size());
+
+  insert(keys[0], 'a', 4);
+  usleep(5000);
+  cacheProbe probe;
+  EXPECT_EQ(CACHE_STALE, lookup(keys[0], &probe));
+  EXPECT_EQ(4U, probe.version);
+  EXPECT_EQ(replyFor(keys[0], 'a'), *probe.reply);
+
+  cacheRevalidated(key, probe);
+  cacheProbe again;
+  EXPECT_EQ(CACHE_HIT, lookup(keys[0], &again));
+
+  // Or the read finds a newer version, which replaces the entry.
+  usleep(5000);
+  lookup(keys[0], &probe);
+  EXPECT_EQ(CACHE_STALE, probe.result);
+  std::string reply = replyFor(keys[0], 'b');
+  cacheInsert(key, probe, reply.data(), reply.size(), 6);
+  EXPECT_EQ(CACHE_HIT, lookup(keys[0], &again));
+  EXPECT_EQ(6U, again.version);
+  EXPECT_EQ(reply, *again.reply);
+}
+
+// A revalidation that finds the key invalidated since its lookup doesn't keep
+// the entry, and isn't counted as a hit.
+TEST(CacheTest, revalidationRaced) {
+  cacheInit(SHARD_BYTES * CACHE_SHARDS, 1);
+  std::vector<std::string> keys = keysInShard("raced", 7, 1);
+  argView key(keys[0].data(), keys[0].size());
+
+  insert(keys[0], 'a', 4);
+  usleep(5000);
+  cacheProbe probe;
+  EXPECT_EQ(CACHE_STALE, lookup(keys[0], &probe));
+
+  cacheStats before;
+  cacheGetStats(&before);
+  cacheInvalidate(key);
+  cacheRevalidated(key, probe);
+  cacheStats after;
+  cacheGetStats(&after);
+  EXPECT_EQ(before.revalidationHits, after.revalidationHits);
+  EXPECT_EQ(before.revalidationsRaced + 1, after.revalidationsRaced);
+
+  cacheProbe again;
+  EXPECT_EQ(CACHE_MISS, lookup(keys[0], &again));
+}
+
+// A hit shares the entry's reply, which stays valid after the entry is gone.
+TEST(CacheTest, sharedReply) {
+  cacheInit(SHARD_BYTES * CACHE_SHARDS, 0);
+  std::vector<std::string> keys = keysInShard("shared", 8, 1);
+  argView key(keys[0].data(), keys[0].size());
+
+  insert(keys[0], 'a', 1);
+  cacheProbe probe, again;
+  EXPECT_EQ(CACHE_HIT, lookup(keys[0], &probe));
+  EXPECT_EQ(CACHE_HIT, lookup(keys[0], &again));
+  EXPECT_EQ(probe.reply.get(), again.reply.get());
+
+  cacheInvalidate(key);
+  EXPECT_EQ(replyFor(keys[0], 'a'), *probe.reply);
+}
@@ -0,0 +1,46 @@
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <gtest/gtest.h>
+#include "commandstats.h"
+#include "Cycles.h"
+
+using RAMCloud::Cycles;
+
+static redisCommand *command(const char *name) {
+  return lookupCommand(name, strlen(name));
+}
+
+// INFO adds up the calls of each command over all executors' tables, and
+// leaves out commands that were never called.
+TEST(CommandStatsTest, mergedOverExecutors) {
+  populateCommandTable();
+  commandStatsInit(2);
+
+  uint64_t fast = Cycles::fromMicroseconds(100);
+  uint64_t slow = Cycles::fromMicroseconds(300);
+  commandStatsRecord(commandStatsTable(0), command("get"), fast, 3);
+  commandStatsRecord(commandStatsTable(1), command("get"), slow, 1);
+  commandStatsRecord(commandStatsTable(1), command("lpush"), fast, 1);
+
+  std::string info;
+  commandStatsInfo(&info);
+  uint64_t usec = Cycles::toMicroseconds(3 * fast + slow);
+  char expected[256];
+  snprintf(expected, sizeof(expected),
+      "cmdstat_get:calls=4,usec=%llu,usec_per_call=%.2f\r\n",
+      (unsigned long long)usec, usec / 4.0);
+  EXPECT_NE(std::string::npos, info.find(expected)) << info;
+  EXPECT_NE(std::string::npos, info.find("cmdstat_lpush:calls=1,")) << info;
+  EXPECT_EQ(std::string::npos, info.find("cmdstat_set:")) << info;
+
+  info.clear();
+  latencyStatsInfo(&info);
+  snprintf(expected, sizeof(expected), "max=%llu\r\n",
+      (unsigned long long)Cycles::toMicroseconds(slow));
+  size_t line = info.find("latency_percentiles_usec_get:p50=");
+  ASSERT_NE(std::string::npos, line) << info;
+  EXPECT_EQ(info.find("\r\n", line) + 2 - strlen(expected),
+      info.find(expected, line)) << info;
+  EXPECT_EQ(std::string::npos, info.find("usec_set:")) << info;
+}
@@ -0,0 +1,107 @@
+#include <stdint.h>
+#include <gtest/gtest.h>
+#include "histogram.h"
+
+// The upper end of the bucket value goes in, as the median of value and a
+// value far above it.
+static uint64_t bucketHighOf(uint64_t value) {
+  histogram h;
+  h.record(value);
+  h.record(UINT64_MAX);
+  histogramSnapshot s;
+  s.add(h);
+  return s.percentile(50);
+}
+
+// Values below 2^HISTOGRAM_SUB_BITS have a bucket each.
+TEST(HistogramTest, exactBuckets) {
+  for (uint64_t v = 0; v < (1 << HISTOGRAM_SUB_BITS); v++)
+    EXPECT_EQ(v, bucketHighOf(v));
+}
+
+// Above that, a bucket is never wider than an eighth of the values in it,
+// and buckets follow each other without gaps, up to the last one.
+TEST(HistogramTest, logLinearBuckets) {
+  uint64_t last = (1ULL << HISTOGRAM_MAX_BITS) -
+      (1ULL << (HISTOGRAM_MAX_BITS - 1 - HISTOGRAM_SUB_BITS));
+  uint64_t v = 1 << HISTOGRAM_SUB_BITS;
+  while (v < last) {
+    uint64_t high = bucketHighOf(v);
+    ASSERT_GE(high, v);
+    ASSERT_LE(high - v, v >> HISTOGRAM_SUB_BITS);
+    ASSERT_EQ(high, bucketHighOf(high));
+    ASSERT_GT(bucketHighOf(high + 1), high);
+    v = high + 1;
+  }
+  EXPECT_EQ(last, v);
+}
+
+// Values from 2^HISTOGRAM_MAX_BITS on all go in the last bucket, which has
+// no end, so percentiles that fall in it are the largest value seen.
+TEST(HistogramTest, lastBucket) {
+  histogram h;
+  h.record(1);
+  h.record(1ULL << HISTOGRAM_MAX_BITS);
+  h.record(1ULL << 50);
+  EXPECT_EQ(2U, h.counts[HISTOGRAM_BUCKETS - 1].load());
+
+  histogramSnapshot s;
+  s.add(h);
+  EXPECT_EQ(1U, s.percentile(30));
+  EXPECT_EQ(1ULL << 50, s.percentile(60));
+  EXPECT_EQ(1ULL << 50, s.percentile(100));
+}
+
+TEST(HistogramTest, percentiles) {
+  histogram h;
+  for (uint64_t v = 1; v <= 1000; v++)
+    h.record(v);
+
+  histogramSnapshot s;
+  s.add(h);
+  EXPECT_EQ(1000U, s.count);
+  EXPECT_EQ(500500U, s.sum);
+  EXPECT_EQ(1U, s.percentile(0));
+  EXPECT_EQ(1000U, s.percentile(100));
+
+  uint64_t p50 = s.percentile(50);
+  EXPECT_GE(p50, 500U);
+  EXPECT_LE(p50, 500U + 500 / 8);
+  uint64_t p99 = s.percentile(99);
+  EXPECT_GE(p99, 990U);
+  EXPECT_LE(p99, 1000U);
+}
+
+// A snapshot adds up histograms, like those of several threads.
+TEST(HistogramTest, snapshotAdd) {
+  histogram a, b;
+  a.record(10, 3);
+  b.record(1000);
+  b.record(3);
+
+  histogramSnapshot s;
+  s.add(a);
+  s.add(b);
+  EXPECT_EQ(5U, s.count);
+  EXPECT_EQ(1033U, s.sum);
+  EXPECT_EQ(1000U, s.max);
+  EXPECT_EQ(3U, s.percentile(20));
+  EXPECT_EQ(bucketHighOf(10), s.percentile(80));
+  EXPECT_EQ(1000U, s.percentile(100));
+
+  histogramSnapshot empty;
+  EXPECT_EQ(0U, empty.percentile(99));
+}
+
+TEST(HistogramTest, clear) {
+  histogram h;
+  h.record(5);
+  h.record(500);
+  h.clear();
+
+  histogramSnapshot s;
+  s.add(h);
+  EXPECT_EQ(0U, s.count);
+  EXPECT_EQ(0U, s.sum);
+  EXPECT_EQ(0U, s.max);
+}
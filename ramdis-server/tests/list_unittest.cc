@@ -0,0 +1,202 @@
+#include <string.h>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include "list.h"
+
+static ListIndexEntry indexEntry(int16_t segId, uint16_t elemCount,
+    uint8_t segSizeKb) {
+  ListIndexEntry entry;
+  memset(&entry, 0, sizeof(entry));
+  entry.segId = segId;
+  entry.elemCount = elemCount;
+  entry.segSizeKb = segSizeKb;
+  return entry;
+}
+
+// Builds a segment by pushing values one at a time, as LPUSH or RPUSH with a
+// single value each would.
+static std::string pushEach(int where, const std::vector<std::string> &values) {
+  std::string seg;
+  uint32_t elemCount = 0;
+  for (auto const& v : values) {
+    argView value(v.data(), v.size());
+    std::string newSegment;
+    listSegmentAdd(seg.data(), seg.size(), elemCount, where, &value, 1,
+        &newSegment);
+    seg.swap(newSegment);
+    elemCount++;
+  }
+  return seg;
+}
+
+// Reads the elements of a segment back, head first.
+static std::vector<std::string> elements(const std::string &seg,
+    uint32_t elemCount) {
+  RAMCloud::Buffer segment;
+  segment.appendCopy(seg.data(), seg.size());
+  std::vector<std::string> values;
+  for (uint32_t i = 0; i < elemCount; i++) {
+    uint32_t offset = listSegmentElementOffset(&segment, elemCount, i);
+    uint16_t len = listSegmentElementLength(&segment, i);
+    EXPECT_LE(offset + len, seg.size());
+    values.push_back(seg.substr(offset, len));
+  }
+  return values;
+}
+
+// An encoded index decodes to what it was, entries and all.
+TEST(ListTest, indexRoundTrip) {
+  listIndex index;
+  index.meta.type = REDIS_LIST;
+  index.entries.push_back(indexEntry(1, 3, 0));
+  index.entries.push_back(indexEntry(0, 700, 5));
+  index.entries.push_back(indexEntry(-1, 1, 0));
+
+  std::string value;
+  listEncodeIndex(index, &value);
+  EXPECT_EQ(sizeof(ObjectMetadata) + 3 * sizeof(ListIndexEntry),
+      value.size());
+
+  RAMCloud::Buffer buffer;
+  buffer.appendCopy(value.data(), value.size());
+  listIndex decoded;
+  ASSERT_EQ(LIST_OK, listDecodeIndex(&buffer, &decoded));
+  EXPECT_EQ(REDIS_LIST, decoded.meta.type);
+  ASSERT_EQ(3U, decoded.entries.size());
+  for (size_t i = 0; i < 3; i++) {
+    EXPECT_EQ(index.entries[i].segId, decoded.entries[i].segId);
+    EXPECT_EQ(index.entries[i].elemCount, decoded.entries[i].elemCount);
+    EXPECT_EQ(index.entries[i].segSizeKb, decoded.entries[i].segSizeKb);
+  }
+  EXPECT_EQ(704U, decoded.length());
+}
+
+// Values that can't be an index, like strings, are of the wrong type.
+TEST(ListTest, decodeWrongType) {
+  listIndex index;
+
+  RAMCloud::Buffer empty;
+  EXPECT_EQ(LIST_WRONGTYPE, listDecodeIndex(&empty, &index));
+
+  RAMCloud::Buffer badSize;
+  std::string value(1 + sizeof(ListIndexEntry) + 1, '\0');
+  value[0] = REDIS_LIST;
+  badSize.appendCopy(value.data(), value.size());
+  EXPECT_EQ(LIST_WRONGTYPE, listDecodeIndex(&badSize, &index));
+
+  RAMCloud::Buffer badType;
+  value.assign(1 + sizeof(ListIndexEntry), '\0');
+  value[0] = REDIS_LIST + 1;
+  badType.appendCopy(value.data(), value.size());
+  EXPECT_EQ(LIST_WRONGTYPE, listDecodeIndex(&badType, &index));
+
+  // A string whose bytes would make an index still has a string's header.
+  RAMCloud::Buffer string;
+  value.assign(1, REDIS_STRING);
+  value.append(1, REDIS_LIST);
+  value.append(sizeof(ListIndexEntry) - 1, '\0');
+  string.appendCopy(value.data(), value.size());
+  EXPECT_EQ(LIST_WRONGTYPE, listDecodeIndex(&string, &index));
+}
+
+// Elements are found by the cumulative element counts of the segments.
+TEST(ListTest, locate) {
+  listIndex index;
+  index.entries.push_back(indexEntry(1, 3, 0));
+  index.entries.push_back(indexEntry(0, 1, 0));
+  index.entries.push_back(indexEntry(-1, 2, 0));
+
+  size_t expectedSeg[] = {0, 0, 0, 1, 2, 2};
+  uint32_t expectedPos[] = {0, 1, 2, 0, 0, 1};
+  for (uint64_t i = 0; i < 6; i++) {
+    uint32_t pos;
+    EXPECT_EQ(expectedSeg[i], listLocate(index, i, &pos));
+    EXPECT_EQ(expectedPos[i], pos);
+  }
+}
+
+// A segment's key, in the segment table, is the raw list key, then the
+// segment id as a length prefixed key component, both little endian.
+TEST(ListTest, segmentKey) {
+  argView key("key", 3);
+  EXPECT_EQ(std::string("key\x02\x00\x05\x00", 7), listSegmentKey(key, 5));
+  EXPECT_EQ(std::string("key\x02\x00\xff\xff", 7), listSegmentKey(key, -1));
+  EXPECT_EQ(std::string("\x02\x00\x00\x01", 4),
+      listSegmentKey(argView("", 0), 256));
+}
+
+// A segment holds the lengths of its elements, then the elements, head first.
+TEST(ListTest, segmentLayout) {
+  std::string seg = pushEach(LIST_TAIL, {"a", "", "ccc"});
+  EXPECT_EQ(std::string("\x01\x00\x00\x00\x03\x00" "accc", 10), seg);
+
+  RAMCloud::Buffer segment;
+  segment.appendCopy(seg.data(), seg.size());
+  EXPECT_EQ(1U, listSegmentElementLength(&segment, 0));
+  EXPECT_EQ(0U, listSegmentElementLength(&segment, 1));
+  EXPECT_EQ(3U, listSegmentElementLength(&segment, 2));
+  EXPECT_EQ(6U, listSegmentElementOffset(&segment, 3, 0));
+  EXPECT_EQ(7U, listSegmentElementOffset(&segment, 3, 1));
+  EXPECT_EQ(7U, listSegmentElementOffset(&segment, 3, 2));
+}
+
+// Pushing several values at once leaves them as pushing them one by one does:
+// in order at the tail, reversed at the head.
+TEST(ListTest, segmentAdd) {
+  std::vector<std::string> values = {"one", "two", "three"};
+  std::vector<argView> argv;
+  for (auto const& v : values)
+    argv.push_back(argView(v.data(), v.size()));
+
+  std::string seg = pushEach(LIST_TAIL, {"x"});
+  std::string tail;
+  listSegmentAdd(seg.data(), seg.size(), 1, LIST_TAIL, argv.data(),
+      argv.size(), &tail);
+  EXPECT_EQ(pushEach(LIST_TAIL, {"x", "one", "two", "three"}), tail);
+  EXPECT_EQ(std::vector<std::string>({"x", "one", "two", "three"}),
+      elements(tail, 4));
+
+  std::string head;
+  listSegmentAdd(seg.data(), seg.size(), 1, LIST_HEAD, argv.data(),
+      argv.size(), &head);
+  EXPECT_EQ(pushEach(LIST_HEAD, {"x", "one", "two", "three"}), head);
+  EXPECT_EQ(std::vector<std::string>({"three", "two", "one", "x"}),
+      elements(head, 4));
+}
+
+// Pops take the element at either end and leave the others as they were.
+TEST(ListTest, segmentRemove) {
+  std::string seg = pushEach(LIST_TAIL, {"a", "bb", "ccc", "dddd"});
+  uint32_t elemCount = 4;
+
+  std::string value, rest;
+  listSegmentRemove(seg.data(), seg.size(), elemCount, LIST_HEAD, &value,
+      &rest);
+  EXPECT_EQ("a", value);
+  EXPECT_EQ(pushEach(LIST_TAIL, {"bb", "ccc", "dddd"}), rest);
+  seg.swap(rest);
+  elemCount--;
+
+  rest.clear();
+  listSegmentRemove(seg.data(), seg.size(), elemCount, LIST_TAIL, &value,
+      &rest);
+  EXPECT_EQ("dddd", value);
+  EXPECT_EQ(pushEach(LIST_TAIL, {"bb", "ccc"}), rest);
+  seg.swap(rest);
+  elemCount--;
+
+  rest.clear();
+  listSegmentRemove(seg.data(), seg.size(), elemCount, LIST_TAIL, &value,
+      &rest);
+  EXPECT_EQ("ccc", value);
+  seg.swap(rest);
+  elemCount--;
+
+  // The last element leaves nothing behind.
+  rest.clear();
+  listSegmentRemove(seg.data(), seg.size(), elemCount, LIST_HEAD, &value,
+      &rest);
+  EXPECT_EQ("bb", value);
+  EXPECT_TRUE(rest.empty());
+}
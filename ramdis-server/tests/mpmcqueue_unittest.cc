@@ -0,0 +1,131 @@
+#include <unistd.h>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include "mpmcqueue.h"
+
+// The capacity is rounded up to a power of two, and a full queue turns
+// enqueues away without touching the value.
+TEST(MpmcQueueTest, capacity) {
+  mpmcQueue<std::string> q(5);
+
+  for (int i = 0; i < 8; i++) {
+    std::string s = std::to_string(i);
+    EXPECT_TRUE(q.tryEnqueue(std::move(s)));
+  }
+  EXPECT_EQ(8U, q.sizeGuess());
+
+  std::string extra("extra");
+  EXPECT_FALSE(q.tryEnqueue(std::move(extra)));
+  EXPECT_EQ("extra", extra);
+
+  std::string s;
+  for (int i = 0; i < 8; i++) {
+    EXPECT_TRUE(q.tryDequeue(&s));
+    EXPECT_EQ(std::to_string(i), s);
+  }
+  EXPECT_FALSE(q.tryDequeue(&s));
+  EXPECT_EQ(0U, q.sizeGuess());
+}
+
+// Slots are reused lap after lap around the ring.
+TEST(MpmcQueueTest, wrapAround) {
+  mpmcQueue<int> q(4);
+
+  int v;
+  for (int i = 0; i < 1000; i++) {
+    int in = i;
+    ASSERT_TRUE(q.tryEnqueue(std::move(in)));
+    if (i % 3 == 2) {
+      for (int j = 0; j < 3; j++)
+        ASSERT_TRUE(q.tryDequeue(&v));
+      EXPECT_EQ(i, v);
+    }
+  }
+}
+
+// Entries are moved through the queue, so it can hold what can't be copied.
+TEST(MpmcQueueTest, moveOnly) {
+  mpmcQueue<std::unique_ptr<int>> q(2);
+
+  std::unique_ptr<int> in(new int(42));
+  EXPECT_TRUE(q.tryEnqueue(std::move(in)));
+  EXPECT_EQ(NULL, in.get());
+
+  std::unique_ptr<int> out;
+  EXPECT_TRUE(q.tryDequeue(&out));
+  EXPECT_EQ(42, *out);
+}
+
+// Several producers and consumers, some of them sleeping in waitDequeue():
+// every value comes out exactly once, and each producer's values come out in
+// the order it put them in.
+TEST(MpmcQueueTest, manyProducersAndConsumers) {
+  const int producers = 4;
+  const int consumers = 4;
+  const int perProducer = 50000;
+  mpmcQueue<int> q(64);
+
+  std::vector<std::vector<int>> seen(consumers);
+  std::vector<std::thread> threads;
+  for (int c = 0; c < consumers; c++) {
+    threads.emplace_back([&, c]() {
+      int v;
+      for (int i = 0; i < producers * perProducer / consumers; i++) {
+        q.waitDequeue(&v);
+        seen[c].push_back(v);
+      }
+    });
+  }
+  for (int p = 0; p < producers; p++) {
+    threads.emplace_back([&, p]() {
+      for (int i = 0; i < perProducer; i++) {
+        int v = p * perProducer + i;
+        while (!q.tryEnqueue(std::move(v)))
+          std::this_thread::yield();
+      }
+    });
+  }
+  for (auto& t : threads)
+    t.join();
+
+  std::vector<int> count(producers * perProducer, 0);
+  for (auto const& values : seen) {
+    std::vector<int> last(producers, -1);
+    for (int v : values) {
+      count[v]++;
+      EXPECT_LT(last[v / perProducer], v);
+      last[v / perProducer] = v;
+    }
+  }
+  for (int n : count)
+    ASSERT_EQ(1, n);
+}
+
+// A consumer sleeping on a shared eventCount wakes up for an enqueue on any
+// of the queues that signal it.
+TEST(MpmcQueueTest, sharedEventCount) {
+  eventCount notEmpty;
+  mpmcQueue<int> a(4, &notEmpty);
+  mpmcQueue<int> b(4, &notEmpty);
+
+  int v = 0;
+  std::thread consumer([&]() {
+    while (true) {
+      uint32_t key = notEmpty.prepareWait();
+      if (a.tryDequeue(&v) || b.tryDequeue(&v)) {
+        notEmpty.cancelWait();
+        return;
+      }
+      notEmpty.wait(key);
+    }
+  });
+
+  usleep(10000);
+  int in = 7;
+  EXPECT_TRUE(b.tryEnqueue(std::move(in)));
+  consumer.join();
+  EXPECT_EQ(7, v);
+}
@@ -0,0 +1,96 @@
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <gtest/gtest.h>
+#include "reply.h"
+
+static std::string ll2str(long long v) {
+  char buf[32];
+  int len = ll2string(buf, sizeof(buf), v);
+  EXPECT_EQ((int)strlen(buf), len);
+  return std::string(buf, len);
+}
+
+// Tests ll2string against printf, around every power of ten and at the ends
+// of the range.
+TEST(Ll2stringTest, matchesPrintf) {
+  std::vector<long long> values = {0, 1, -1, 9, -9, 99, 100, LLONG_MAX,
+    LLONG_MIN, LLONG_MIN + 1};
+  for (long long p = 10; p <= LLONG_MAX / 10; p *= 10) {
+    values.push_back(p - 1);
+    values.push_back(p);
+    values.push_back(p + 1);
+    values.push_back(-p);
+  }
+
+  for (long long v : values) {
+    char expected[32];
+    snprintf(expected, sizeof(expected), "%lld", v);
+    EXPECT_EQ(expected, ll2str(v));
+  }
+}
+
+// Tests that ll2string returns 0 if the digits, sign and null terminator don't
+// all fit.
+TEST(Ll2stringTest, tooSmall) {
+  char buf[4];
+  EXPECT_EQ(3, ll2string(buf, 4, 123));
+  EXPECT_STREQ("123", buf);
+  EXPECT_EQ(0, ll2string(buf, 4, 1234));
+  EXPECT_EQ(0, ll2string(buf, 4, -123));
+  EXPECT_EQ(3, ll2string(buf, 4, -12));
+  EXPECT_STREQ("-12", buf);
+  EXPECT_EQ(0, ll2string(buf, 1, 0));
+}
+
+TEST(ReplyBufferTest, encoding) {
+  replyBuffer r;
+
+  addReplyStatus(&r, "OK");
+  addReplyLongLong(&r, -42);
+  addReplyArrayLen(&r, 2);
+  addReplyBulk(&r, "foo", 3);
+  addReplyBulk(&r, "", 0);
+  addReplyNull(&r);
+  EXPECT_EQ("+OK\r\n:-42\r\n*2\r\n$3\r\nfoo\r\n$0\r\n\r\n$-1\r\n",
+      takeReply(&r));
+  EXPECT_TRUE(r.buf.empty());
+}
+
+// Errors get "-ERR " unless they carry a code of their own, and can't break
+// the protocol with line breaks.
+TEST(ReplyBufferTest, errors) {
+  replyBuffer r;
+
+  addReplyError(&r, "bad\r\nthing");
+  EXPECT_EQ("-ERR bad  thing\r\n", takeReply(&r));
+
+  addReplyError(&r, "-WRONGTYPE no");
+  EXPECT_EQ("-WRONGTYPE no\r\n", takeReply(&r));
+
+  addReplyErrorFormat(&r, "%d is %s", 7, "odd");
+  EXPECT_EQ("-ERR 7 is odd\r\n", takeReply(&r));
+}
+
+// Small replies are copied out and the buffer keeps its capacity. Big ones
+// take the buffer with them, and it is allocated again.
+TEST(ReplyBufferTest, takeReply) {
+  replyBuffer r;
+  EXPECT_GE(r.buf.capacity(), (size_t)REPLY_BUFFER_SIZE);
+
+  addReplyBulk(&r, "x", 1);
+  const char *small = r.buf.data();
+  std::string reply = takeReply(&r);
+  EXPECT_EQ("$1\r\nx\r\n", reply);
+  EXPECT_EQ(small, r.buf.data());
+
+  std::string big(REPLY_BUFFER_SIZE * 2, 'y');
+  addReplyBulk(&r, big.data(), big.size());
+  const char *data = r.buf.data();
+  reply = takeReply(&r);
+  EXPECT_EQ(data, reply.data());
+  EXPECT_EQ(big.size() + 10, reply.size());
+  EXPECT_TRUE(r.buf.empty());
+  EXPECT_GE(r.buf.capacity(), (size_t)REPLY_BUFFER_SIZE);
+}
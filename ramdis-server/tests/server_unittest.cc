@@ -0,0 +1,251 @@
+#include <ctype.h>
+#include <fcntl.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include "ramdis-server.h"
+#include "sds.h"
+
+extern mpmcQueue<request> *requestQ;
+extern uint32_t clientMaxInflight;
+extern std::vector<reactor*> reactors;
+
+static redisCommand *lookup(const std::string &name) {
+  return lookupCommand(name.data(), name.size());
+}
+
+// Whether cmd is NULL or the command called name, as some names are a
+// prefix of others, like LPUSH of LPUSHX.
+static bool isNameOf(const std::string &name, redisCommand *cmd) {
+  return cmd == NULL || strcasecmp(cmd->name, name.c_str()) == 0;
+}
+
+// Every command in the table is found by its name, in any case.
+TEST(CommandTableTest, lookupEveryCommand) {
+  populateCommandTable();
+  for (int i = 0; i < commandCount(); i++) {
+    std::string name = redisCommandTable[i].name;
+    EXPECT_EQ(&redisCommandTable[i], lookup(name)) << name;
+
+    std::string upper = name;
+    for (auto& ch : upper)
+      ch = toupper(ch);
+    EXPECT_EQ(&redisCommandTable[i], lookup(upper)) << upper;
+  }
+}
+
+// Names that hash to a command's slot aren't taken for it unless they match.
+TEST(CommandTableTest, lookupUnknown) {
+  populateCommandTable();
+  EXPECT_TRUE(lookup("get") != NULL);
+  EXPECT_EQ(NULL, lookup(""));
+  EXPECT_EQ(NULL, lookup("ge"));
+  EXPECT_EQ(NULL, lookup("gett"));
+  EXPECT_EQ(NULL, lookup("get "));
+  EXPECT_EQ(NULL, lookup("nosuchcommand"));
+  EXPECT_EQ(NULL, lookup(std::string("get\0", 4)));
+  for (int i = 0; i < commandCount(); i++) {
+    std::string name = redisCommandTable[i].name;
+    EXPECT_TRUE(isNameOf(name + "z", lookup(name + "z"))) << name;
+    std::string prefix = name.substr(0, name.size() - 1);
+    EXPECT_TRUE(isNameOf(prefix, lookup(prefix))) << name;
+  }
+}
+
+// Commands that block their executor in a RAMCloud transaction stay out of
+// the fast lane.
+TEST(CommandTableTest, listWritesAreSlow) {
+  populateCommandTable();
+  const char *slow[] = {"lpush", "rpush", "lpop", "rpop", "lset"};
+  for (const char *name : slow)
+    EXPECT_FALSE(lookup(name)->flags & CMD_FAST) << name;
+  EXPECT_TRUE(lookup("get")->flags & CMD_FAST);
+  EXPECT_TRUE(lookup("llen")->flags & CMD_FAST);
+}
+
+// Commands that run a RAMCloud transaction in their proc are flagged for the
+// executor to hold back until its other RPCs are done.
+TEST(CommandTableTest, listTransactions) {
+  populateCommandTable();
+  const char *tx[] = {"lpop", "rpop", "lindex", "lset", "lrange"};
+  for (const char *name : tx)
+    EXPECT_TRUE(lookup(name)->flags & CMD_TRANSACTION) << name;
+  EXPECT_FALSE(lookup("get")->flags & CMD_TRANSACTION);
+  EXPECT_FALSE(lookup("llen")->flags & CMD_TRANSACTION);
+  EXPECT_FALSE(lookup("rpush")->flags & CMD_TRANSACTION);
+}
+
+// Clients of a reactor that is never run, connected to sockets nobody writes
+// to, for dispatchReadyClients() to schedule.
+class DispatchTest : public ::testing::Test {
+ protected:
+  DispatchTest() : loop(0, 16), peers() {}
+
+  virtual void SetUp() {
+    populateCommandTable();
+    requestQ = new mpmcQueue<request>(1024);
+    clientMaxInflight = 0;
+  }
+
+  virtual void TearDown() {
+    for (clientBuffer *c : loop.clients) {
+      if (c != NULL) {
+        close(c->fd);
+        delete c;
+      }
+    }
+    for (int fd : peers)
+      close(fd);
+    delete requestQ;
+    requestQ = NULL;
+  }
+
+  clientBuffer *newClient() {
+    int fds[2];
+    EXPECT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+    fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+    peers.push_back(fds[1]);
+
+    clientBuffer *c = new clientBuffer(fds[0], &loop);
+    if (loop.clients.size() <= (size_t)c->fd)
+      loop.clients.resize(c->fd + 1, NULL);
+    loop.clients[c->fd] = c;
+    return c;
+  }
+
+  // Parses n INCRs on keys of their own, as if the client had pipelined
+  // them, and puts the client on the reactor's list.
+  void submitIncrs(clientBuffer *c, int n) {
+    for (int i = 0; i < n; i++) {
+      std::string key = std::to_string(c->id) + ":" + std::to_string(i);
+      std::string args = "INCR\r\n" + key + "\r\n";
+      std::shared_ptr<queryBuffer> buf =
+          std::make_shared<queryBuffer>(sdsnewlen(args.data(), args.size()));
+      c->argv.push_back(argView(buf->buf, 4));
+      c->argv.push_back(argView(buf->buf + 6, key.size()));
+      c->argvBufs.push_back(buf);
+      submitCommand(c);
+    }
+    scheduleClient(c);
+  }
+
+  // Empties the request queue, returning the ids of the clients whose
+  // requests were in it, run length encoded: "1x16 2x4" for sixteen requests
+  // from client 1 followed by four from client 2.
+  std::string drain() {
+    std::string runs;
+    uint64_t last = 0;
+    int n = 0;
+    request req;
+    while (requestQ->tryDequeue(&req)) {
+      if (n > 0 && req.clientId != last) {
+        runs += std::to_string(last) + "x" + std::to_string(n) + " ";
+        n = 0;
+      }
+      last = req.clientId;
+      n++;
+    }
+    if (n > 0)
+      runs += std::to_string(last) + "x" + std::to_string(n);
+    return runs;
+  }
+
+  reactor loop;
+  std::vector<int> peers;
+};
+
+// A client with a deep pipeline gets CLIENT_QUANTUM requests a round, and
+// one with a few has them all dispatched in between.
+TEST_F(DispatchTest, deficitRoundRobin) {
+  ASSERT_EQ(16, CLIENT_QUANTUM);
+  clientBuffer *a = newClient();
+  clientBuffer *b = newClient();
+  submitIncrs(a, 40);
+  submitIncrs(b, 4);
+
+  dispatchReadyClients(&loop);
+  EXPECT_EQ(std::to_string(a->id) + "x16 " + std::to_string(b->id) + "x4 " +
+      std::to_string(a->id) + "x24", drain());
+  EXPECT_TRUE(loop.readyClients.empty());
+  EXPECT_FALSE(a->inReadyClients);
+  EXPECT_EQ(0U, a->deficit);
+  EXPECT_EQ(40U, a->inflight);
+  EXPECT_EQ(4U, b->inflight);
+}
+
+// A client at the in-flight limit leaves the list until it is scheduled
+// again, once replies are in.
+TEST_F(DispatchTest, inflightLimit) {
+  clientMaxInflight = 5;
+  clientBuffer *a = newClient();
+  clientBuffer *b = newClient();
+  submitIncrs(a, 12);
+  submitIncrs(b, 3);
+
+  dispatchReadyClients(&loop);
+  EXPECT_EQ(std::to_string(a->id) + "x5 " + std::to_string(b->id) + "x3",
+      drain());
+  EXPECT_FALSE(a->inReadyClients);
+  EXPECT_EQ(7U, a->readyQ.size());
+
+  a->inflight = 0;
+  scheduleClient(a);
+  dispatchReadyClients(&loop);
+  EXPECT_EQ(std::to_string(a->id) + "x5", drain());
+  EXPECT_EQ(2U, a->readyQ.size());
+}
+
+// A client that finds the request queue full keeps its place at the front of
+// the list, and its deficit, and stops reading until it has dispatched all
+// its ready requests.
+TEST_F(DispatchTest, queueFull) {
+  delete requestQ;
+  requestQ = new mpmcQueue<request>(8);
+  clientBuffer *a = newClient();
+  clientBuffer *b = newClient();
+  submitIncrs(a, 10);
+  submitIncrs(b, 2);
+
+  dispatchReadyClients(&loop);
+  EXPECT_EQ(2U, loop.readyClients.size());
+  EXPECT_EQ(a->fd, loop.readyClients.front());
+  EXPECT_TRUE(a->readPaused);
+  EXPECT_EQ(8U, a->deficit);
+  EXPECT_EQ(std::to_string(a->id) + "x8", drain());
+
+  dispatchReadyClients(&loop);
+  EXPECT_EQ(std::to_string(a->id) + "x2 " + std::to_string(b->id) + "x2",
+      drain());
+  EXPECT_TRUE(loop.readyClients.empty());
+  EXPECT_FALSE(a->readPaused);
+}
+
+// CLIENT LIST waits for the reactor to take a snapshot, which it only does
+// when asked, so it shows the clients as they are.
+TEST_F(DispatchTest, clientListOnDemand) {
+  loop.eventfd = eventfd(0, EFD_NONBLOCK);
+  reactors.push_back(&loop);
+  clientBuffer *a = newClient();
+  submitIncrs(a, 3);
+
+  takeClientList(&loop);
+  EXPECT_TRUE(loop.clientListSnapshot.empty());
+
+  std::string list;
+  std::thread executor([&]() { clientList(&list); });
+  while (loop.clientListTakenFor == 0)
+    takeClientList(&loop);
+  executor.join();
+  EXPECT_EQ(0U, list.find("id=" + std::to_string(a->id) + " "));
+  EXPECT_NE(std::string::npos, list.find(" pipeline=3 ready=3 inflight=0 "));
+
+  reactors.clear();
+  close(loop.eventfd);
+}
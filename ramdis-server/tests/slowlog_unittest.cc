@@ -0,0 +1,99 @@
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include "slowlog.h"
+
+// Returns a request for argv, pointing into buf as parsed requests point
+// into their query buffer.
+static request makeRequest(const std::vector<std::string> &args,
+    std::string *buf) {
+  for (auto const& a : args)
+    buf->append(a);
+  request req;
+  size_t offset = 0;
+  for (auto const& a : args) {
+    req.argv.push_back(argView(buf->data() + offset, a.size()));
+    offset += a.size();
+  }
+  return req;
+}
+
+// Only the newest entries are kept, newest first.
+TEST(SlowlogTest, trimming) {
+  slowlogInit(0, 3);
+  EXPECT_EQ(0U, slowlogSlowerThan);
+
+  slowlogList log;
+  std::vector<uint64_t> ids;
+  for (int i = 0; i < 5; i++) {
+    std::string buf;
+    request req = makeRequest({"GET", "k" + std::to_string(i)}, &buf);
+    std::unique_ptr<slowlogEntry> entry = slowlogCreate(req);
+    ids.push_back(entry->id);
+    slowlogPush(&log, std::move(entry));
+  }
+
+  ASSERT_EQ(3U, log.entries.size());
+  for (int i = 0; i < 3; i++) {
+    EXPECT_EQ(ids[4 - i], log.entries[i]->id);
+    EXPECT_EQ("k" + std::to_string(4 - i), log.entries[i]->argv[1]);
+  }
+  EXPECT_LT(ids[0], ids[4]);
+}
+
+// An entry SLOWLOG GET took a copy of the pointer to stays intact after it is
+// trimmed from the log.
+TEST(SlowlogTest, sharedEntries) {
+  slowlogInit(0, 1);
+  slowlogList log;
+  std::string oldBuf, newBuf;
+  request req = makeRequest({"GET", "old"}, &oldBuf);
+  slowlogPush(&log, slowlogCreate(req));
+  std::shared_ptr<const slowlogEntry> held = log.entries.front();
+
+  req = makeRequest({"GET", "new"}, &newBuf);
+  slowlogPush(&log, slowlogCreate(req));
+  ASSERT_EQ(1U, log.entries.size());
+  EXPECT_EQ("new", log.entries.front()->argv[1]);
+  EXPECT_EQ("old", held->argv[1]);
+  EXPECT_EQ(1, held.use_count());
+}
+
+// A negative threshold or a length of 0 leaves the slow log off.
+TEST(SlowlogTest, disabled) {
+  slowlogSlowerThan = UINT64_MAX;
+  slowlogInit(-1, 10);
+  EXPECT_EQ(UINT64_MAX, slowlogSlowerThan);
+  slowlogInit(100, 0);
+  EXPECT_EQ(UINT64_MAX, slowlogSlowerThan);
+  EXPECT_FALSE(slowlogIsSlow(UINT64_MAX - 1));
+}
+
+// Long arguments are cut short, and the last argument kept says how many
+// more there were.
+TEST(SlowlogTest, truncation) {
+  std::vector<std::string> args = {"RPUSH",
+    std::string(SLOWLOG_ENTRY_MAX_STRING + 10, 'x'),
+    std::string(SLOWLOG_ENTRY_MAX_STRING, 'y')};
+  while (args.size() < SLOWLOG_ENTRY_MAX_ARGC + 5)
+    args.push_back("v");
+  std::string buf;
+  request req = makeRequest(args, &buf);
+  std::unique_ptr<slowlogEntry> entry = slowlogCreate(req);
+
+  ASSERT_EQ((size_t)SLOWLOG_ENTRY_MAX_ARGC, entry->argv.size());
+  EXPECT_EQ("RPUSH", entry->argv[0]);
+  EXPECT_EQ(std::string(SLOWLOG_ENTRY_MAX_STRING, 'x') + "... (10 more bytes)",
+      entry->argv[1]);
+  EXPECT_EQ(args[2], entry->argv[2]);
+  EXPECT_EQ("v", entry->argv[SLOWLOG_ENTRY_MAX_ARGC - 2]);
+  EXPECT_EQ("... (6 more arguments)", entry->argv[SLOWLOG_ENTRY_MAX_ARGC - 1]);
+
+  // Exactly SLOWLOG_ENTRY_MAX_ARGC arguments are all kept.
+  args.resize(SLOWLOG_ENTRY_MAX_ARGC);
+  buf.clear();
+  req = makeRequest(args, &buf);
+  entry = slowlogCreate(req);
+  ASSERT_EQ((size_t)SLOWLOG_ENTRY_MAX_ARGC, entry->argv.size());
+  EXPECT_EQ("v", entry->argv[SLOWLOG_ENTRY_MAX_ARGC - 1]);
+}